@@ -0,0 +1,143 @@
+#include "Checkpoint.h"
+#include "Container.h"
+#include "MappedFile.h"
+#include <cstring>
+
+static const int IO_BUFFER_SIZE = 1 << 20;
+static const int PARTICLE_BATCH = 1 << 14;
+
+static inline long long AlignUp(long long offset)
+{
+	return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+static void PadTo(FILE *fp, long long &offset, long long target)
+{
+	static const char zeros[CHECKPOINT_ALIGN] = { 0 };
+	if(target > offset) fwrite(zeros, 1, size_t(target - offset), fp);
+	offset = target;
+}
+
+bool SaveCheckpoint(const char *filename, const Container &contain)
+{
+	const Grid &phi = contain.lset.GetPhi();
+	int nx, ny, nz, size;
+	phi.GetSize(nx, ny, nz, size);
+
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, "PLSCHKP");
+	header.version = CHECKPOINT_VERSION;
+	header.byteOrder = CHECKPOINT_BYTEORDER;
+	header.headerSize = sizeof(CheckpointHeader);
+	header.nx = nx; header.ny = ny; header.nz = nz;
+	header.dt = contain.dt;
+	header.time = contain.time;
+	header.numCells = size;
+	header.numParticles = contain.pset.Count();
+	header.phiOffset = AlignUp(sizeof(CheckpointHeader));
+	header.particleOffset = AlignUp(header.phiOffset + header.numCells * sizeof(Double));
+	header.seed = contain.pset.GetSeed();
+	header.reseeds = contain.pset.GetReseeds();
+
+	FILE *fp = fopen(filename, "wb");
+	if(fp == NULL) {
+		cerr << "couldn't open " << filename << " for writing" << endl;
+		return false;
+	}
+	char *buffer = new char[IO_BUFFER_SIZE];
+	setvbuf(fp, buffer, _IOFBF, IO_BUFFER_SIZE);
+
+	long long offset = sizeof(CheckpointHeader);
+	fwrite(&header, sizeof(CheckpointHeader), 1, fp);
+
+	PadTo(fp, offset, header.phiOffset);
+	fwrite(&phi[0], sizeof(Double), size_t(size), fp);
+	offset += header.numCells * sizeof(Double);
+
+	PadTo(fp, offset, header.particleOffset);
+	vector<CheckpointParticle> batch;
+	batch.reserve(PARTICLE_BATCH);
+	for(ParticleSet::cIterator it = contain.pset.begin(); it != contain.pset.end(); ++it) {
+		CheckpointParticle record;
+		MakeParticleRecord(it->Decode(), record);
+		batch.push_back(record);
+		if(int(batch.size()) == PARTICLE_BATCH) {
+			fwrite(&batch[0], sizeof(CheckpointParticle), batch.size(), fp);
+			batch.clear();
+		}
+	}
+	if(!batch.empty()) fwrite(&batch[0], sizeof(CheckpointParticle), batch.size(), fp);
+	offset += header.numParticles * sizeof(CheckpointParticle);
+
+	bool ok = !ferror(fp);
+	if(fclose(fp) != 0) ok = false;
+	delete [] buffer;
+	if(!ok) cerr << "error writing " << filename << endl;
+	return ok;
+}
+
+static bool CheckHeader(const CheckpointHeader &header, size_t fileSize, const Grid &phi)
+{
+	int nx, ny, nz, size;
+	phi.GetSize(nx, ny, nz, size);
+	if(strncmp(header.magic, "PLSCHKP", 8) != 0) return false;
+	if(header.byteOrder != CHECKPOINT_BYTEORDER) return false;
+	if(header.version != CHECKPOINT_VERSION || header.headerSize != sizeof(CheckpointHeader)) 
+		return false;
+	if(header.nx != nx || header.ny != ny || header.nz != nz || header.numCells != size) 
+		return false;
+	// both sections are aligned as SaveCheckpoint writes them, follow each other and lie 
+	// inside the file (the counts are checked by division so they can't overflow)
+	long long phiEnd = header.phiOffset + header.numCells * (long long) sizeof(Double);
+	if(header.phiOffset % CHECKPOINT_ALIGN != 0 || header.particleOffset % CHECKPOINT_ALIGN != 0)
+		return false;
+	if(header.phiOffset < (long long) sizeof(CheckpointHeader) || phiEnd > (long long) fileSize)
+		return false;
+	if(header.particleOffset < phiEnd || header.particleOffset > (long long) fileSize || 
+	   header.numParticles < 0)
+		return false;
+	return header.numParticles <= 
+		   ((long long) fileSize - header.particleOffset) / (long long) sizeof(CheckpointParticle);
+}
+
+void MakeParticleRecord(const Particle &particle, CheckpointParticle &record)
+{
+	Vector pos;
+	particle.GetPosition(pos);
+	record.position[0] = pos[0]; record.position[1] = pos[1]; record.position[2] = pos[2];
+	record.radius = particle.Radius();
+	record.sign = particle.Sign();
+	record.pad = 0;
+}
+
+bool LoadCheckpoint(const char *filename, Container &contain)
+{
+	MappedFile *file = new MappedFile;
+	if(!file->Open(filename, true)) {
+		delete file;
+		return false;
+	}
+	if(file->Size() < sizeof(CheckpointHeader) || 
+	   !CheckHeader(*(const CheckpointHeader*) file->Data(), file->Size(), contain.lset.GetPhi())) {
+		cerr << filename << " is not a checkpoint of this simulation" << endl;
+		delete file;
+		return false;
+	}
+	const CheckpointHeader &header = *(const CheckpointHeader*) file->Data();
+
+	contain.pset.Clear();
+	const CheckpointParticle *record = 
+		(const CheckpointParticle*) (file->Data() + header.particleOffset);
+	for(long long p = 0; p < header.numParticles; p++, record++) {
+		Vector pos(record->position[0], record->position[1], record->position[2]);
+		contain.pset.Add(Particle(pos, record->sign, record->radius));
+	}
+	contain.pset.SetSeed(header.seed, header.reseeds);
+	contain.dt = header.dt;
+	contain.time = header.time;
+
+	// the grid owns the mapping from here on
+	contain.lset.GetPhi().Adopt((Double*) (file->Data() + header.phiOffset), file);
+	return true;
+}
@@ -0,0 +1,90 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	Checkpoint: Saving and restoring the complete state of a simulation
+	
+	SaveCheckpoint	- writes the level set, the particles (position, sign and radius), the 
+					  time, the timestep and the seed and reseed count of the particle 
+					  generator of a Container to a binary file
+	LoadCheckpoint	- restores a Container from a file written by SaveCheckpoint. The file
+					  is memory mapped copy-on-write and the level set grid adopts the phi 
+					  section of the mapping directly, so nothing is parsed or copied for it.
+					  Only the particle list is rebuilt. The Container has to have the same 
+					  grid size as the one that was saved.
+
+	The file is written in host byte order and starts with a CheckpointHeader. The phi values
+	(same layout as Grid, buffer cells included) and the particle records follow at the 
+	offsets given in the header, each aligned to CHECKPOINT_ALIGN bytes.
+	Files with another version, byte order or grid size are rejected.
+
+	MakeParticleRecord fills a CheckpointParticle from a particle, for other files and 
+	snapshots that store particles the same way.
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "main.h"
+
+class Container;
+class Particle;
+
+const unsigned int CHECKPOINT_VERSION	= 3;
+const unsigned int CHECKPOINT_ALIGN		= 64;
+const unsigned int CHECKPOINT_BYTEORDER	= 0x01020304;
+
+struct CheckpointHeader
+{
+	char magic[8];					// "PLSCHKP"
+	unsigned int version;
+	unsigned int byteOrder;			// CHECKPOINT_BYTEORDER as written by the saving host
+	unsigned int headerSize;
+	int nx, ny, nz;
+	int count;						// unused (was Container::count), written as 0
+	Double dt;
+	Double time;					// Container::time (version 2)
+	long long phiOffset, numCells;
+	long long particleOffset, numParticles;
+	unsigned int seed, reseeds;		// ParticleSet::GetSeed and GetReseeds (version 3)
+};
+
+struct CheckpointParticle
+{
+	Double position[3];
+	Double radius;
+	int sign;
+	int pad;
+};
+
+void MakeParticleRecord(const Particle &particle, CheckpointParticle &record);
+bool SaveCheckpoint(const char *filename, const Container &contain);
+bool LoadCheckpoint(const char *filename, Container &contain);
+
+#endif
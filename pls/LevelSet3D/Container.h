@@ -30,13 +30,31 @@
 /*
 	Container: A class for representing and working with the levelset library as a whole. 
 			  
-	The class holds a LevelSet, a ParticleSet, a VelocityGrid, and a timestep
+	The class holds a LevelSet, a ParticleSet, a VelocityGrid, and a timestep. The velocity
+	grid is a VortexVelocity unless another field (a MACVelocity filled by a fluid solver, 
+	for instance) is given to SetVelocity. The Container does not own that field.
 	
 	Functions:
 	GetVelocity		- returns the velocity at the given point
-	Update			- This is the actual simulator. The steps are pretty selfexplanatory
+	advection		- the Interpolation used by the semi-lagrangian advection of the level set
+	reseedPolicy	- decides at the end of every Update, from the FixStatistics of the step
+					  (stats), whether the particles are topped up, reseeded or left alone
+	correction		- the Interpolation used to sample the level set at the particles in Fix
+					  and Reseed. Both can be changed between steps
+	resample		- if set, the second Fix of a step is LevelSet::FixAndResample, which also
+					  updates the particle radii (Section 3.4 in the paper)
+	sortEvery,		- the particles are sorted in Morton order (ParticleSet::Sort) at the end
+	sortDisorder	  of a step if sortEvery steps went by since the last sort, or if their
+					  ParticleSet::Disorder is above sortDisorder. 0 turns each trigger off, 
+					  and both are off by default
+	Update			- This is the actual simulator. The steps are pretty selfexplanatory.
+					  They are run as a TaskGraph on the shared TaskPool, so the level set 
+					  and the particles are advected at the same time. Fix waits for both
 	Clear			- resets the grid to its original form
 	
+	Containers share no state but the TaskPool, so independent Containers can be stepped on
+	different threads at the same time.
+	
 	MakeSphere:
 	This function will initialize the values in the grid "init" to create an implicit surface 
 	representing Zalesaks sphere. A function like this is necessary to create the initial grid 
@@ -56,6 +74,8 @@
 #include "LevelSet.h"
 #include "ParticleSet.h"
 #include "Velocity.h"
+#include "TaskGraph.h"
+#include "ReseedPolicy.h"
 
 void MakeSphere(Grid &init, Double h, const Vector &pos, Double radius);
 
@@ -64,7 +84,9 @@ class Container
 public:
     Container(int nx, int ny, int nz, Double h) 
         : fm(nx,ny,nz,h), lset(nx,ny,nz,h), pset(nx,ny,nz,h), 
-          grid(nx,ny), init(nx,ny,nz), dt(DT), Nx(nx), Ny(ny) 
+          grid(nx,ny), velocity(&grid), init(nx,ny,nz), dt(DT), Nx(nx), Ny(ny), Nz(nz),
+          advection(INTERP_LINEAR), correction(INTERP_LINEAR), resample(false),
+          sortEvery(0), sortDisorder(0) 
 	{ MakeSphere(init, h, (Vector(Nx,Ny,Nz) * Vector(0.5, 0.75, 0.5)) + Vector(1,1,1), .15 * Ny );
 	  Clear(); }
 	
@@ -76,7 +98,7 @@ public:
     void GetVelocity(int i, int j, int k, Double &u, Double &v, Double &w)
     {
         Vector uv(u,v,w);
-        grid.GetVelocity(Vector(i,j,k),uv);
+        velocity->GetVelocity(Vector(i,j,k),uv);
         u = uv[0];
         v = uv[1];
         w = uv[2];
@@ -86,36 +108,87 @@ public:
 	{
 		//THE VELOCITY GRID WOULD BE UPDATED HERE. THIS EXAMPLE IS USING A CONTANT VELOCITY
 		//GRID WHICH CREATES A RIGID BODY ROTATION OF THE IMPLICIT SURFACE
-		lset.Update(grid,dt);
-		pset.Update(grid,dt);
-		lset.Fix(pset);
-		lset.ReInitialize(fm);
-		lset.Fix(pset);
-		//See Section 3.4 in the paper for activating the lines below
-		//pset.Resample(lset);
-
-		//count++;
-		//if(count % 20 == 0) pset.Reseed(lset);
+		velocity->SetTime(time);
+		stats = FixStatistics();
+		MethodTask<Container> advectLevelSet(this, &Container::AdvectLevelSet);
+		MethodTask<Container> advectParticles(this, &Container::AdvectParticles);
+		MethodTask<Container> fix(this, &Container::FixLevelSet);
+		MethodTask<Container> reinitialize(this, &Container::ReInitialize);
+		MethodTask<Container> fixAgain(this, resample ? &Container::FixAndResample : &Container::FixLevelSet);
+		MethodTask<Container> reseed(this, &Container::ReseedParticles);
+		MethodTask<Container> sort(this, &Container::SortParticles);
+
+		TaskGraph graph;
+		int lsetUpdate = graph.Add(&advectLevelSet);
+		int psetUpdate = graph.Add(&advectParticles);
+		int lsetFix = graph.Add(&fix);
+		int lsetReInit = graph.Add(&reinitialize);
+		int lsetFixAgain = graph.Add(&fixAgain);
+		graph.Depend(lsetFix, lsetUpdate);
+		graph.Depend(lsetFix, psetUpdate);
+		graph.Depend(lsetReInit, lsetFix);
+		graph.Depend(lsetFixAgain, lsetReInit);
+		int psetReseed = graph.Add(&reseed);
+		graph.Depend(psetReseed, lsetFixAgain);
+		int psetSort = graph.Add(&sort);
+		graph.Depend(psetSort, psetReseed);
+		graph.Run(TaskPool::Shared());
+		time += dt;
+	}
+
+	// stages of Update
+	void AdvectLevelSet()	{ lset.Update(*velocity,dt,advection); }
+	void AdvectParticles()	{ pset.Update(*velocity,dt); }
+	void FixLevelSet()		{ stats.Accumulate(lset.Fix(pset, correction)); }
+	void FixAndResample()	{ stats.Accumulate(lset.FixAndResample(pset, correction)); }
+	void ReInitialize()		{ lset.ReInitialize(fm); }
+	void ReseedParticles()
+	{
+		switch(reseedPolicy.Decide(stats)) {
+		case ReseedPolicy::RESEED_LOCAL: pset.TopUp(lset, correction); break;
+		case ReseedPolicy::RESEED_FULL:  pset.Reseed(lset, correction); break;
+		default: break;
+		}
 	}
+	void SortParticles()
+	{
+		unsortedSteps++;
+		if((sortEvery > 0 && unsortedSteps >= sortEvery) || 
+		   (sortDisorder > 0 && pset.Disorder() > sortDisorder)) {
+			pset.Sort();
+			unsortedSteps = 0;
+		}
+	}
+
+	// NULL goes back to the built in vortex
+	void SetVelocity(Velocity *field) { velocity = field != NULL ? field : &grid; }
 
     void Clear()
     {
 		lset.Initialize(init);
-		pset.Reseed(lset);
-		count = 0;
+		pset.Reseed(lset, correction);
+		time = 0;
+		unsortedSteps = 0;
     }
 
 	LevelSet lset;
     FastMarch fm;
 	ParticleSet pset;
-	Velocity grid;
+	VortexVelocity grid;
+	Velocity *velocity;
     int Nx, Ny, Nz;
     Double dt;
-    int count;
+	Double time;	// simulated time, given to the velocity field at the start of each step
+	Interpolation advection, correction;
+	bool resample;
+	int sortEvery, unsortedSteps;
+	Double sortDisorder;
+	ReseedPolicy reseedPolicy;
+	FixStatistics stats;	// of the last step
 	Grid init;
 };
 
-void MakeSphere(Grid &init, Double h, const Vector &pos, Double radius)
+inline void MakeSphere(Grid &init, Double h, const Vector &pos, Double radius)
 {
 	FOR_ALL_LS
 		Double val1 = ((pos - Vector(i,j,k)).Length() - radius) * h; 
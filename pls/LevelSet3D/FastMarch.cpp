@@ -1,4 +1,58 @@
 #include "FastMarch.h"
+#include "TaskPool.h"
+
+// Sets the cells of the slabs k = begin ... end-1 to the values of from, or to their own 
+// values if from is NULL. from may have a wider buffer than the FMContainer grid
+struct FastMarch::SetSlabs
+{
+	FastMarch *fm;
+	const Grid *from;
+	void operator()(int begin, int end) const
+	{
+		for(int k = begin; k < end; k++)
+			for(int j = 0; j <= fm->Ny+1; j++) {
+				int index = fm->GI(0,j,k);
+				if(from == NULL) {
+					for(int i = 0; i <= fm->Nx+1; i++, index++) fm->Set(index, fm->grid[index].value);
+					continue;
+				}
+				const Double *row = &(*from)[from->Index(0,j,k)];
+				for(int i = 0; i <= fm->Nx+1; i++, index++) fm->Set(index, row[i]);
+			}
+	}
+};
+
+// copies the values of the slabs k = begin ... end-1 of lset (counted from its first buffer
+// slab) into lset. The buffer cells are set to boundary if fillBoundary is set, which covers 
+// the buffer layers the FMContainer grid does not have
+struct FastMarch::CopySlabs
+{
+	const FastMarch *fm;
+	Grid *lset;
+	bool fillBoundary;
+	Double boundary;
+	void operator()(int begin, int end) const
+	{
+		int Nx = fm->Nx, Ny = fm->Ny, Nz = fm->Nz, ghost = lset->GetGhost();
+		for(int k = begin + 1-ghost; k < end + 1-ghost; k++)
+			for(int j = 1-ghost; j <= Ny+ghost; j++) {
+				Double *row = &(*lset)(0,j,k);
+				if(k < 1 || k > Nz || j < 1 || j > Ny) {
+					if(fillBoundary) 
+						for(int i = 1-ghost; i <= Nx+ghost; i++) row[i] = boundary;
+					else if(k >= 0 && k <= Nz+1 && j >= 0 && j <= Ny+1) 
+						for(int i = 0; i <= Nx+1; i++) row[i] = fm->grid[fm->GI(i,j,k)].value;
+					continue;
+				}
+				const FMContainer *cells = &fm->grid[fm->GI(0,j,k)];
+				for(int i = 0; i <= Nx+1; i++) row[i] = cells[i].value;
+				if(fillBoundary) {
+					for(int i = 1-ghost; i <= 0; i++) row[i] = boundary;
+					for(int i = Nx+1; i <= Nx+ghost; i++) row[i] = boundary;
+				}
+			}
+	}
+};
 
 FastMarch::FastMarch(int nx,int ny, int nz, Double hi) 
     : Nx(nx), Ny(ny), Nz(nz), h(hi), hInv(1./hi), size((nx+2)*(ny+2)*(nz+2)), 
@@ -10,13 +64,31 @@ FastMarch::FastMarch(int nx,int ny, int nz, Double hi)
 }
 
 void FastMarch::Reinitialize(Grid &lset) {
+	Reinitialize(lset, false, 0);
+}
+
+void FastMarch::Reinitialize(Grid &lset, const Double &boundary) {
+	Reinitialize(lset, true, boundary);
+}
+
+void FastMarch::Reinitialize(Grid &lset, bool fillBoundary, const Double &boundary) {
+	SetSlabs set;
+	set.fm = this;
     //Negative Phi first
-    FOR_GRID Set(i, lset[i]);
+	set.from = &lset;
+	ParallelFor(TaskPool::Shared(), 0, Nz+2, 1, set);
 	ReinitHalf();
     //Then Positive Phi
-    FOR_GRID Set(i, grid[i].value);
+	set.from = NULL;
+	ParallelFor(TaskPool::Shared(), 0, Nz+2, 1, set);
     ReinitHalf();
-    FOR_GRID lset[i] = grid[i].value;
+
+	CopySlabs copy;
+	copy.fm = this;
+	copy.lset = &lset;
+	copy.fillBoundary = fillBoundary;
+	copy.boundary = boundary;
+	ParallelFor(TaskPool::Shared(), 0, Nz + 2*lset.GetGhost(), 1, copy);
 }
 
 inline void FastMarch::ReinitHalf() {
@@ -60,7 +132,7 @@ void FastMarch::SetBoundary()
 }
 
 void FastMarch::Initialize() {
-    static int ci, pi, flag;
+    int ci, pi, flag;
 	for(int i = 1; i <= Nx; i++)
 	{
         for(int j = 1; j <= Ny; j++)
@@ -155,7 +227,7 @@ inline void FastMarch::AddClose(int index)
 }
 
 void FastMarch::InitHeap() {
-    static int x,y,z;
+    int x,y,z;
 	for(int i = 0; i < closeSize; i++) {
 		if(grid[ClosePoints[i]].HeapPosition == -1 && grid[ClosePoints[i]].DoneFlag == 0) {
 			GIJK(ClosePoints[i], x, y, z);
@@ -165,9 +237,9 @@ void FastMarch::InitHeap() {
 }
 
 void FastMarch::FindPhi(int index, int x, int y, int z) {
-	static Double phiX, phiY, phiZ, b, quotient, phi;
-    static int a;
-    static bool flagX, flagY, flagZ;
+	Double phiX, phiY, phiZ, b, quotient, phi;
+    int a;
+    bool flagX, flagY, flagZ;
 
     phiX = phiY = phiZ = 0.;
     a = 0;
@@ -277,7 +349,7 @@ void FastMarch::UpdateHeap(int index) {
 }
 
 void FastMarch::March() {
-	static int x, y, z; 
+	int x, y, z; 
 	for(int index = PopHeap(); index != -1; index = PopHeap()) {
 		if(grid[index].value > FASTMARCH_LIMIT) return;
 		GIJK(index, x, y, z);
@@ -42,6 +42,11 @@
 	Reinitialize	- Performs the fastmarching method on the FMContainer grid. It is assumed
 					  that the values to be reset are in the FMContainer grid and that is where
 					  the updated grid values will be when the function is done.
+					  Loading lset into the FMContainer grid, loading it again between the
+					  two halves and copying the result back are parallel sweeps over 
+					  z-slabs. If a boundary value is given, the boundary cells of lset are
+					  set to it in the sweep that copies the result back, which saves a 
+					  separate pass like Grid::SetBoundarySignedDist
 	
 	Private Functions:
 	PopHeap			- Called by FastMarch, it pops the current closest grid value from the heap 
@@ -84,6 +89,7 @@
 					  done by stepping through the ClosePoints list and calling FindPhi for each cell
 					  that isn't already in the heap
 	AddClose		- Adds cell to ClosePoints list.
+	SetSlabs, CopySlabs - the parallel sweeps of Reinitialize
 					  
 
 	Created by Emud Mokhberi: UCLA : 09/04/04
@@ -110,6 +116,7 @@ public:
 
     inline void Set(int index, const Double &value);
     void Reinitialize(Grid &lset);
+    void Reinitialize(Grid &lset, const Double &boundary);
 
 private:
 	int PopHeap();
@@ -127,6 +134,9 @@ private:
 	void Initialize();		
 	void InitHeap();
     inline void AddClose(int index);
+    void Reinitialize(Grid &lset, bool fillBoundary, const Double &boundary);
+    struct SetSlabs;
+    struct CopySlabs;
 
     inline int GI(int i, int j, int k) const { return i + dj*j + dk*k; }
 	inline void GIJK(int index, int& i, int& j, int& k)
@@ -0,0 +1,165 @@
+#include "FrameOutput.h"
+#include "MeshIO.h"
+#include "PPM.H"
+#include "ParticleSet.h"
+#include "VolumeSequence.h"
+
+FrameWriter::FrameWriter(int num, int cap, FramePolicy pol)
+	: threads(NULL), numThreads(0), capacity(max(cap, 1)), active(0), dropped(0), 
+	  policy(pol), quit(false)
+{
+	if(num <= 0) return;
+	threads = new Thread[num];
+	for(int t = 0; t < num; t++) {
+		if(!threads[t].Start(Run, this)) break;
+		numThreads++;
+	}
+	if(numThreads == 0) cerr << "FrameWriter: could not start a writer thread, writing in place" << endl;
+}
+
+FrameWriter::~FrameWriter()
+{
+	Finish();
+	mutex.Lock();
+	quit = true;
+	changed.Broadcast();
+	mutex.Unlock();
+	for(int t = 0; t < numThreads; t++) threads[t].Join();
+	delete [] threads;
+}
+
+bool FrameWriter::Submit(FrameJob *job)
+{
+	if(numThreads == 0) {
+		job->Write();
+		delete job;
+		return true;
+	}
+
+	mutex.Lock();
+	while(policy == FRAME_BLOCK && int(queue.size()) >= capacity) changed.Wait(mutex);
+	if(int(queue.size()) >= capacity) {
+		dropped++;
+		mutex.Unlock();
+		delete job;
+		return false;
+	}
+	queue.push_back(job);
+	changed.Broadcast();
+	mutex.Unlock();
+	return true;
+}
+
+void FrameWriter::Finish()
+{
+	MutexLock lock(mutex);
+	while(!queue.empty() || active > 0) changed.Wait(mutex);
+}
+
+int FrameWriter::Dropped()
+{
+	MutexLock lock(mutex);
+	return dropped;
+}
+
+void FrameWriter::Run(void *self)
+{
+	((FrameWriter*) self)->Work();
+}
+
+// the first queued job whose channel is free. Called with the mutex held
+FrameJob* FrameWriter::Next()
+{
+	for(deque<FrameJob*>::iterator it = queue.begin(); it != queue.end(); ++it) {
+		const void *channel = (*it)->Channel();
+		if(channel != NULL && find(busy.begin(), busy.end(), channel) != busy.end()) continue;
+		FrameJob *job = *it;
+		queue.erase(it);
+		return job;
+	}
+	return NULL;
+}
+
+void FrameWriter::Work()
+{
+	mutex.Lock();
+	for(;;) {
+		FrameJob *job = Next();
+		if(job == NULL) {
+			if(quit && queue.empty()) break;
+			changed.Wait(mutex);
+			continue;
+		}
+		const void *channel = job->Channel();
+		if(channel != NULL) busy.push_back(channel);
+		active++;
+		changed.Broadcast();	// there is room in the queue now
+		mutex.Unlock();
+
+		job->Write();
+		delete job;
+
+		mutex.Lock();
+		if(channel != NULL) busy.erase(find(busy.begin(), busy.end(), channel));
+		active--;
+		changed.Broadcast();
+	}
+	mutex.Unlock();
+}
+
+void MeshFrame::Write()
+{
+	if(!povFile.empty()) {
+		FILE *fp = fopen(povFile.c_str(), "w");
+		if(fp == NULL) cerr << "could not open " << povFile << endl;
+		else {
+			WritePOVRay(fp, mesh);
+			fputc('\n', fp);
+			fclose(fp);
+		}
+	}
+	if(!plyFile.empty()) WritePLY(plyFile.c_str(), mesh);
+	if(!meshFile.empty()) WriteMesh(meshFile.c_str(), mesh);
+}
+
+PPMFrame::PPMFrame(const string &file, int buffer, int w, int h)
+	: filename(file), width(w), height(h), pixels(3 * w * h)
+{
+	if(!pixels.empty()) ReadPPM(&pixels[0], buffer, width, height);
+}
+
+void PPMFrame::Write()
+{
+	FILE *fp = fopen(filename.c_str(), "w");
+	if(fp == NULL) {
+		cerr << "could not open " << filename << endl;
+		return;
+	}
+	if(!pixels.empty()) WritePPM(fp, &pixels[0], width, height);
+	fclose(fp);
+}
+
+void PhiFrame::Write()
+{
+	writer.WriteFrame(grid);
+}
+
+ParticleFrame::ParticleFrame(const string &file, const ParticleSet &set)
+	: filename(file), particles(set.begin(), set.end())
+{
+}
+
+void ParticleFrame::Write()
+{
+	FILE *fp = fopen(filename.c_str(), "wb");
+	if(fp == NULL) {
+		cerr << "could not open " << filename << endl;
+		return;
+	}
+	vector<CheckpointParticle> records(particles.size());
+	for(size_t p = 0; p < particles.size(); p++) MakeParticleRecord(particles[p].Decode(), records[p]);
+	int count = int(records.size());
+	fwrite(&count, sizeof(int), 1, fp);
+	if(count > 0) fwrite(&records[0], sizeof(CheckpointParticle), records.size(), fp);
+	fclose(fp);
+}
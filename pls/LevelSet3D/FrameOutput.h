@@ -0,0 +1,156 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	FrameOutput: Writing frame data on background threads
+
+	Instead of writing files itself, the simulation hands a FrameJob to a FrameWriter and
+	carries on right away. A job owns a snapshot of everything it writes, so the simulation
+	is free to change its own data. Jobs are written and deleted by the writer threads.
+	
+	The queue holds at most capacity jobs. When it is full, Submit either waits for room 
+	(FRAME_BLOCK) or throws the new job away (FRAME_DROP). A writer with 0 threads writes
+	every job in Submit, which is useful for debugging.
+
+	Jobs with the same (non NULL) Channel are written one at a time and in the order they 
+	were submitted. This is needed when several frames go to the same file. Jobs without a
+	channel are written in any order.
+
+	FrameWriter:
+	Submit			- queues a job and takes ownership of it. Returns false if it was dropped
+	Finish			- waits until every queued job has been written
+	Dropped			- number of jobs dropped so far
+
+	Jobs:
+	MeshFrame		- takes over the mesh of an IsoSurface (no copy, the surface is left 
+					  empty) and writes it to the files that are set: POV-Ray, PLY and/or 
+					  the native mesh format
+	PPMFrame		- grabs the frame buffer when it is created and writes it as a PPM
+	PhiFrame		- a copy of phi, appended to a VolumeWriter
+	ParticleFrame	- a copy of the particles as CompactParticles, decoded when the job is
+					  written, as an int count followed by CheckpointParticle records
+*/
+
+#ifndef FRAMEOUTPUT_H
+#define FRAMEOUTPUT_H
+
+#include "main.h"
+#include "Thread.h"
+#include "Grid.h"
+#include "impsurface.h"
+#include "Checkpoint.h"
+#include "Particle.h"
+
+class ParticleSet;
+class VolumeWriter;
+
+class FrameJob
+{
+public:
+	virtual ~FrameJob() {}
+	virtual void Write() = 0;
+	virtual const void* Channel() const { return NULL; }
+};
+
+enum FramePolicy { FRAME_BLOCK, FRAME_DROP };
+
+class FrameWriter
+{
+public:
+	FrameWriter(int numThreads = 1, int capacity = 4, FramePolicy policy = FRAME_BLOCK);
+	~FrameWriter();
+
+	bool Submit(FrameJob *job);
+	void Finish();
+	int Dropped();
+
+private:
+	FrameWriter(const FrameWriter&);
+	FrameWriter& operator=(const FrameWriter&);
+
+	static void Run(void *self);
+	void Work();
+	FrameJob* Next();
+
+	deque<FrameJob*> queue;
+	vector<const void*> busy;	// channels being written
+	Mutex mutex;
+	Condition changed;			// broadcast on every change of queue, busy or active
+	Thread *threads;
+	int numThreads, capacity, active, dropped;
+	FramePolicy policy;
+	bool quit;
+};
+
+class MeshFrame : public FrameJob
+{
+public:
+	MeshFrame(IsoSurface &surface) { mesh.swap(surface); }
+	void Write();
+
+	string povFile, plyFile, meshFile;	// empty ones are skipped
+private:
+	IsoSurface mesh;
+};
+
+class PPMFrame : public FrameJob
+{
+public:
+	PPMFrame(const string &file, int buffer, int width, int height);
+	void Write();
+private:
+	string filename;
+	int width, height;
+	vector<unsigned char> pixels;
+};
+
+class PhiFrame : public FrameJob
+{
+public:
+	PhiFrame(const Grid &phi, VolumeWriter &out) : grid(phi), writer(out) {}
+	void Write();
+	const void* Channel() const { return &writer; }
+private:
+	Grid grid;
+	VolumeWriter &writer;
+};
+
+class ParticleFrame : public FrameJob
+{
+public:
+	ParticleFrame(const string &file, const ParticleSet &set);
+	ParticleFrame(const string &file, const vector<CompactParticle> &compact)
+		: filename(file), particles(compact) {}
+	void Write();
+private:
+	string filename;
+	vector<CompactParticle> particles;
+};
+
+#endif
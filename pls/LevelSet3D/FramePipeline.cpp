@@ -0,0 +1,99 @@
+#include "FramePipeline.h"
+#include "Container.h"
+
+void FrameSnapshot::Take(const Container &contain)
+{
+	phi = contain.lset.GetPhi();
+	particles.assign(contain.pset.begin(), contain.pset.end());
+}
+
+void FrameSnapshot::SetInterpolation(Interpolation interp)
+{
+	interpolation = interp;
+	switch(interp) {
+	case INTERP_CUBIC:		 sample = &CubicInterpolation::Sample; break;
+	case INTERP_CATMULL_ROM: sample = &CatmullRomInterpolation::Sample; break;
+	default:				 sample = &LinearInterpolation::Sample; break;
+	}
+}
+
+Double FrameSnapshot::eval(const Point3d& location)
+{
+	Vector pos((location[0] + 1) * (phi.GetNx()-1) * 0.5 + 1, 
+			   (location[1] + 1) * (phi.GetNy()-1) * 0.5 + 1,
+			   (location[2] + 1) * (phi.GetNz()-1) * 0.5 + 1);
+	return sample(phi, pos[0], pos[1], pos[2]);
+}
+
+FramePipeline::FramePipeline(Container &c)
+	: contain(c), 
+	  front(c.lset.GetPhi().GetNx(), c.lset.GetPhi().GetNy(), c.lset.GetPhi().GetNz()),
+	  back(c.lset.GetPhi().GetNx(), c.lset.GetPhi().GetNy(), c.lset.GetPhi().GetNz()),
+	  requested(false), pending(false), quit(false)
+{
+}
+
+FramePipeline::~FramePipeline()
+{
+	if(!thread.Running()) return;
+	mutex.Lock();
+	quit = true;
+	changed.Broadcast();
+	mutex.Unlock();
+	thread.Join();
+}
+
+bool FramePipeline::Start()
+{
+	if(thread.Running()) return true;
+	return thread.Start(Run, this);
+}
+
+void FramePipeline::Next(bool step)
+{
+	if(!thread.Running()) {
+		if(step) contain.Update();
+		front.Take(contain);
+		return;
+	}
+
+	MutexLock lock(mutex);
+	while(requested) changed.Wait(mutex);
+	if(pending) front.Swap(back);
+	else front.Take(contain);
+	pending = step;
+	if(step) {
+		requested = true;
+		changed.Broadcast();
+	}
+}
+
+void FramePipeline::Sync()
+{
+	MutexLock lock(mutex);
+	while(requested) changed.Wait(mutex);
+	pending = false;
+}
+
+void FramePipeline::Run(void *self)
+{
+	((FramePipeline*) self)->Simulate();
+}
+
+void FramePipeline::Simulate()
+{
+	mutex.Lock();
+	for(;;) {
+		while(!requested && !quit) changed.Wait(mutex);
+		if(quit) break;
+		mutex.Unlock();
+
+		contain.Update();
+		back.Take(contain);
+
+		mutex.Lock();
+		requested = false;
+		changed.Broadcast();
+	}
+	mutex.Unlock();
+}
@@ -0,0 +1,118 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	FramePipeline: Simulating the next frame while the current one is meshed and drawn
+
+	The simulation thread runs Container::Update for frame N+1 while the caller meshes, draws 
+	and writes frame N. The caller never looks at the Container itself while a step is 
+	running. It works on a FrameSnapshot instead: a copy of phi and of the particles taken by
+	the simulation thread right after its step. The level set still needs its phi for the 
+	next step, so phi is copied once per frame. The particles are copied as they are stored,
+	12 byte CompactParticles, and only decoded when they are drawn or written out. There 
+	are two snapshots. The simulation thread fills the back one, and Next hands it to the 
+	caller by swapping buffers with the front one, so handing a frame over copies nothing 
+	more. A frame therefore costs about as much as the slower of the two sides instead of 
+	their sum.
+
+	FramePipeline:
+	Start		- starts the simulation thread. Without it, Next steps the Container itself
+	Next		- waits for the step started by the last call and makes its result the 
+				  front snapshot. If step is true, the following step is started
+	Sync		- waits for the running step and drops its result. Has to be called before
+				  the Container is used directly (checkpoints, Clear, ...). The next frame 
+				  then shows the Container as it is
+	Front		- the snapshot of the current frame. Its address never changes, so it can 
+				  be given to an IsoSurface once
+
+	FrameSnapshot is an ImpSurface with the same coordinates as LevelSet::eval. It samples phi
+	with the instantiation of the interpolation policy picked by SetInterpolation (linear by
+	default), so eval does not branch on the Interpolation.
+*/
+
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include "main.h"
+#include "Grid.h"
+#include "Interpolation.h"
+#include "impsurface.h"
+#include "Particle.h"
+#include "Thread.h"
+
+class Container;
+
+class FrameSnapshot : public ImpSurface
+{
+public:
+	FrameSnapshot(int nx, int ny, int nz) : phi(nx,ny,nz) { SetInterpolation(INTERP_LINEAR); }
+
+	void Take(const Container &contain);
+	void Swap(FrameSnapshot &other) { phi.Swap(other.phi); particles.swap(other.particles); }
+	void SetInterpolation(Interpolation interp);
+	inline Interpolation GetInterpolation() const { return interpolation; }
+	virtual Double eval(const Point3d& location);
+
+	Grid phi;
+	vector<CompactParticle> particles;
+
+private:
+	Interpolation interpolation;
+	Double (*sample)(const Grid &phi, Double x, Double y, Double z);
+};
+
+class FramePipeline
+{
+public:
+	FramePipeline(Container &c);
+	~FramePipeline();
+
+	bool Start();
+	void Next(bool step);
+	void Sync();
+	inline FrameSnapshot& Front() { return front; }
+
+private:
+	FramePipeline(const FramePipeline&);
+	FramePipeline& operator=(const FramePipeline&);
+
+	static void Run(void *self);
+	void Simulate();
+
+	Container &contain;
+	FrameSnapshot front, back;
+	Thread thread;
+	Mutex mutex;
+	Condition changed;
+	bool requested;		// the simulation thread has a step to do (or is doing it)
+	bool pending;		// back holds a step the caller has not seen yet
+	bool quit;
+};
+
+#endif
@@ -32,15 +32,27 @@
 	The grid is created with a 1 cell buffer on each side. However, note that these
 	buffer cells are not hidden from the user. That means that indexing the grid
 	with for instance (0,0,0) will return a buffer cell and not the first non-buffer cell.
+	A wider buffer (up to GRID_MAX_GHOST cells) can be asked for when the grid is constructed.
+	The cells then go from 1-ghost to N+ghost along each axis, and a 4 point stencil like the 
+	cubic and Catmull-Rom samplers use fits without clamping at every point of [0, N] 
+	(GetGhost() >= 2). Buffer positions (operator[], Index, Coordinates) depend on the width, 
+	so grids whose buffers are combined position by position must have the same one.
 	
 	The grid can be initialized based on an input array that does not contain the 1 cell
 	buffer. This can be done when the grid is constructed or by calling the "set" function.
 	Note that the 1 cell boundary has to be set after this is done to ensure proper boundary
-	conditions.
+	conditions. Both copy the array; a GridView addresses it in place.
+
+	Arithmetic between Grids and numbers (a = b + dt * c) is lazy, see GridExpr. It is 
+	evaluated when assigned to a Grid, in one parallel pass. The in place operators, dot,
+	normSqrd, norm and MaxAbs go through the same kernels.
 	
 	
 	Boundary functions are provided to set the boundary cells to certain values depending
-	on the use of the grid. The current boundary functions are:
+	on the use of the grid. They all go through FillBoundary, which sets every buffer cell
+	(faces, edges and corners of all the buffer layers) in one parallel sweep over z-slabs,
+	from the nearest non-buffer cell and a boundary condition given as template parameter. 
+	The current boundary functions are:
 	Dirichlet - boundary cells are set to 0
 	Neumann - boundary cells are set to the value of the adjacent cell
 	Velocity U - x-axis boundaries are set to the negative value of their neighbors
@@ -49,9 +61,22 @@
 				 x-axis and z-axis boundaries are set as Neumann
 	Velocity W - z-axis boundaries are set to the negative value of their neighbors
 				 x-axis and y-axis boundaries are set as Neumann	
-	SignedDistance - This is currently set to 3 times the cell size with the only purpose
-					 being to make sure that the boundary is always considered outside of
-					 of the implicit surface
+				 For the velocities, edges and corners take the value of the nearest 
+				 non-buffer cell, negated if they lie beyond a negated face
+				 The fill used to set the faces first and average them into the edges
+				 and corners (SetBoundaryCorner). For Neumann that gives the same values,
+				 except for the last bit of some corners (a third of three times the 
+				 value). For the velocities the edges beyond one negated face averaged a
+				 value and its negation, so they were 0; now they are the negated value
+	SignedDistance - This is currently set to 3 times the cell size (BOUNDARY_PHI) with the 
+					 only purpose being to make sure that the boundary is always considered 
+					 outside of of the implicit surface
+
+	Adopt can be used to hand the grid a buffer it did not allocate itself (for instance
+	memory mapped from a checkpoint file). The buffer has to hold the full grid including
+	the buffer cells. The GridStorage object that owns the buffer is deleted together with
+	the grid, or when another buffer is adopted. Swap exchanges the buffers (and their owners) 
+	of two grids of the same size without copying any values.
 
 	Created by Emud Mokhberi: UCLA : 09/04/04
 */
@@ -59,28 +84,79 @@
 #ifndef GRID_H
 #define GRID_H
 #include "main.h"
+#include "TaskPool.h"
+#include "GridExpr.h"
+
+const Double BOUNDARY_PHI = 3. * HH;	// of SetBoundarySignedDist
+const int GRID_MAX_GHOST = 3;			// widest buffer of a Grid
+
+// Owner of a buffer adopted by a Grid. Deleting it releases the buffer.
+class GridStorage
+{
+public:
+	virtual ~GridStorage() {}
+};
 
 class Grid
 {
 private:
-	inline int GI(int i, int j, int k) const { return i + dj*j + dk*k; }
+	inline int GI(int i, int j, int k) const { return i + dj*j + dk*k + origin; }
 
 	int Nx, Ny, Nz, size, dj, dk;
+	int ghost;            // width of the buffer on each side
+	int origin;           // position of (0,0,0) in the buffer
 	Double *grid;
+	GridStorage *storage; // owner of an adopted buffer, if any
+	bool owned;           // grid was allocated with new []
+
+	inline void Release() 
+		{ if(storage != NULL) delete storage; if(owned && grid != NULL) delete [] grid; }
+	inline void Layout(int g)
+	{
+		ghost = Clamp(g, 1, GRID_MAX_GHOST);
+		dj = Nx + 2*ghost; 
+		dk = dj * (Ny + 2*ghost);
+		size = dk * (Nz + 2*ghost);
+		origin = (ghost - 1) * (1 + dj + dk);
+	}
+	template<class Boundary> struct FillSlabs;
+	template<class E> struct EvaluateCells;
 
 public:
-	Grid(int nx, int ny, int nz) : Nx(nx), Ny(ny), Nz(nz), dj(Nx+2), dk((Nx+2)*(Ny+2))
-		{ size = (nx+2) * (ny+2) * (nz+2); grid = new Double[size]; fill(grid, grid+size, 0.); }
-    Grid(int nx, int ny, int nz, Float c) : Nx(nx), Ny(ny), Nz(nz), dj(Nx+2), dk((Nx+2)*(Ny+2))
-		{ size = (nx+2) * (ny+2) * (nz+2); grid = new Double[size]; fill(grid, grid+size, c); }
-	Grid(const Grid &gi) 
-		{ gi.GetSize(Nx, Ny, Nz, size); dj = Nx+2; dk = (Nx+2) * (Ny+2);
-          grid = new Double[size]; FOR_GRID grid[i] = gi[i]; }
-	Grid(int nx, int ny, int nz, const Double val[]) : Nx(nx), Ny(ny), Nz(nz)
-		{ size = (nx+2) * (ny+2) * (nz+2); grid = new Double[size]; 
+	Grid(int nx, int ny, int nz) : Nx(nx), Ny(ny), Nz(nz), storage(NULL), owned(true)
+		{ Layout(1); grid = new Double[size]; fill(grid, grid+size, 0.); }
+    Grid(int nx, int ny, int nz, Float c, int g = 1) : Nx(nx), Ny(ny), Nz(nz), storage(NULL), owned(true)
+		{ Layout(g); grid = new Double[size]; fill(grid, grid+size, c); }
+	Grid(const Grid &gi) : Nx(gi.Nx), Ny(gi.Ny), Nz(gi.Nz), storage(NULL), owned(true)
+		{ Layout(gi.ghost); grid = new Double[size]; FOR_GRID grid[i] = gi[i]; }
+	Grid(int nx, int ny, int nz, const Double val[]) 
+		: Nx(nx), Ny(ny), Nz(nz), storage(NULL), owned(true)
+		{ Layout(1); grid = new Double[size]; 
 		  for (int k=1; k<=nz; k++) for(int j=1; j<=ny; j++) for(int i=1; i<=nx; i++) 
 		  grid[GI(i,j,k)] = val[(k-1)*ny*nx + (j-1)*nx + (i-1)]; }
-	~Grid() { if(grid != NULL) delete [] grid; }
+	// a grid on a buffer it did not allocate, see Adopt
+	Grid(int nx, int ny, int nz, Double *buf, GridStorage *owner, int g = 1)
+		: Nx(nx), Ny(ny), Nz(nz), grid(buf), storage(owner), owned(false) { Layout(g); }
+	~Grid() { Release(); }
+
+	// takes over buf (the GetSize values of the grid) and its owner; owner may be NULL for 
+	// memory that outlives the grid
+	inline void Adopt(Double *buf, GridStorage *owner) 
+		{ Release(); grid = buf; storage = owner; owned = false; }
+	// position of (i,j,k) in the buffer, as used by operator[]
+	inline int Index(int i, int j, int k) const { return GI(i,j,k); }
+	// the (i,j,k) of a position in the buffer
+	inline void Coordinates(int index, int &i, int &j, int &k) const
+		{ index -= origin; k = index / dk; index -= k * dk; j = index / dj; i = index - j * dj; }
+	inline int GetGhost() const { return ghost; }
+	// distance in the buffer between neighbors along y and z
+	inline void GetStrides(int &sj, int &sk) const { sj = dj; sk = dk; }
+	inline void Swap(Grid &gi)
+	{
+		swap(Nx, gi.Nx); swap(Ny, gi.Ny); swap(Nz, gi.Nz); swap(size, gi.size);
+		swap(dj, gi.dj); swap(dk, gi.dk); swap(ghost, gi.ghost); swap(origin, gi.origin);
+		swap(grid, gi.grid); swap(storage, gi.storage); swap(owned, gi.owned); 
+	}
 			
 	inline Double& operator[] (int index) { return grid[index]; }
 	inline const Double& operator[] (int index) const { return grid[index]; }
@@ -90,12 +166,28 @@ public:
 	operator Double*() { return &grid[0]; }
 	operator const Double*() { return &grid[0]; }
 
-	inline Grid& operator=(const Grid &gi)  { FOR_GRID grid[i] = gi[i]; return *this; }
-	inline Grid& operator+=(const Grid &gi) { FOR_GRID grid[i] += gi[i]; return *this;}
-	inline Grid& operator-=(const Grid &gi) { FOR_GRID grid[i] -= gi[i]; return *this;}
-	inline Grid& operator*=(Double c)		 { FOR_GRID grid[i] *= c; return *this; }
-	inline Grid& operator/=(Double c) 
-		{ Double cInv = 1. / c; FOR_GRID grid[i] *= cInv; return *this; }
+	// takes the size and buffer width of gi if they differ
+	inline Grid& operator=(const Grid &gi)  
+	{ 
+		if(gi.Nx != Nx || gi.Ny != Ny || gi.Nz != Nz || gi.ghost != ghost) {
+			Release();
+			Nx = gi.Nx; Ny = gi.Ny; Nz = gi.Nz;
+			Layout(gi.ghost);
+			grid = new Double[size]; storage = NULL; owned = true;
+		}
+		FOR_GRID grid[i] = gi[i]; 
+		return *this; 
+	}
+	// evaluates expr into the grid, which has to be of the size of the Grids in it
+	template<class E> Grid& operator=(const GridExpr<E> &expr);
+	template<class E> Grid& operator+=(const GridExpr<E> &expr) { return *this = Expr() + expr; }
+	template<class E> Grid& operator-=(const GridExpr<E> &expr) { return *this = Expr() - expr; }
+	inline Grid& operator+=(const Grid &gi) { return *this = Expr() + gi.Expr(); }
+	inline Grid& operator-=(const Grid &gi) { return *this = Expr() - gi.Expr(); }
+	inline Grid& operator*=(Double c)		 { return *this = Expr() * c; }
+	inline Grid& operator/=(Double c)		 { return *this = Expr() / c; }
+	// the cells of the grid as a term of an expression
+	inline GridExpr<GridTerm> Expr() const { return GridExpr<GridTerm>(GridTerm(grid), size); }
 
     inline int GetNx() const { return Nx; }
     inline int GetNy() const { return Ny; }
@@ -104,10 +196,10 @@ public:
 	inline void set(const Double val[])
 		{ for (int k=1; k<=Nz; k++) for(int j=1; j<=Ny; j++) for(int i=1; i<=Nx; i++) 
 		  grid[GI(i,j,k)] = val[(k-1)*Ny*Nx + (j-1)*Nx + (i-1)]; }
-	inline Double dot(const Grid& gi) const
-		{ Double ret = 0; FOR_GRID ret += grid[i] * gi[i]; return ret; }
+	inline Double dot(const Grid& gi) const { return Dot(Expr(), gi.Expr()); }
 	inline Double normSqrd() const { return (*this).dot(*this); }
 	inline Double norm() const { return sqrt(normSqrd()); }
+	inline Double MaxAbs() const { return ::MaxAbs(Expr()); }
 	void Normalize() { (*this) /= norm();}
     inline void Clear() { fill(grid, grid+size, 0.); }
 	inline void GetSize(int &nx, int &ny, int &nz, int &s) const 
@@ -131,169 +223,131 @@ public:
 	inline void SetBoundaryU();
 	inline void SetBoundaryV();
     inline void SetBoundaryW();
-	inline void SetBoundaryCorner();	
     inline void SetBoundarySignedDist();
+	template<class Boundary> void FillBoundary(const Boundary &boundary);
 };
 
-inline void Grid::SetBoundaryDirichlet()
-{
-    FOR_GRIDZY grid[GI(0,j,k)] = grid[GI(Nx+1,j,k)] = 0; END_FOR_TWO
-    FOR_GRIDZX grid[GI(i,0,k)] = grid[GI(i,Ny+1,k)] = 0; END_FOR_TWO
-    FOR_GRIDYX grid[GI(i,j,0)] = grid[GI(i,j,Nz+1)] = 0; END_FOR_TWO
-    for(int k=1 ; k<=Nz ; k++ ) {
-		grid[GI(0,0   ,k)] = grid[GI(Nx+1,0   ,k)] = 0;
-        grid[GI(0,Ny+1,k)] = grid[GI(Nx+1,Ny+1,k)] = 0;
-	}
-	for(int j=1 ; j<=Ny ; j++ ) {
-		grid[GI(0,j,0   )] = grid[GI(Nx+1,j,0   )] = 0;
-        grid[GI(0,j,Nz+1)] = grid[GI(Nx+1,j,Nz+1)] = 0;
-	}
-	for(int i=1 ; i<=Nx; i++ ) { 
-		grid[GI(i,0,0   )] = grid[GI(i,Ny+1,0   )] = 0;
-        grid[GI(i,0,Nz+1)] = grid[GI(i,Ny+1,Nz+1)] = 0;
-	}
-    grid[GI(0   ,0   ,0   )] = grid[GI(Nx+1,0   ,0   )] = 0;
-	grid[GI(0   ,Ny+1,0   )] = grid[GI(0   ,0   ,Nz+1)] = 0;
-    grid[GI(Nx+1,Ny+1,0   )] = grid[GI(Nx+1,0   ,Nz+1)] = 0;
-    grid[GI(0   ,Ny+1,Nz+1)] = grid[GI(Nx+1,Ny+1,Nz+1)] = 0;
-}
+// Boundary conditions for Grid::FillBoundary. The value of ghost cell (i,j,k) is computed
+// from the nearest interior cell (ci,cj,ck)
 
-inline void Grid::SetBoundaryNeumann()
+struct DirichletBoundary
 {
-    FOR_GRIDZY
-        grid[GI(0   ,j,k)] = grid[GI(1 ,j,k)];
-        grid[GI(Nx+1,j,k)] = grid[GI(Nx,j,k)];
-    END_FOR_TWO
-    FOR_GRIDZX
-        grid[GI(i,0   ,k)] = grid[GI(i,1 ,k)];
-        grid[GI(i,Ny+1,k)] = grid[GI(i,Ny,k)];
-    END_FOR_TWO
-    FOR_GRIDYX
-        grid[GI(i,j,0   )] = grid[GI(i,j,1 )];
-        grid[GI(i,j,Nz+1)] = grid[GI(i,j,Nz)];
-    END_FOR_TWO
-	SetBoundaryCorner();
-}
+	inline Double operator()(const Grid &g, int i, int j, int k, int ci, int cj, int ck) const
+		{ return 0; }
+};
 
-inline void Grid::SetBoundaryU()
+struct NeumannBoundary
 {
-    FOR_GRIDZY
-        grid[GI(0   ,j,k)] = -grid[GI(1 ,j,k)];
-        grid[GI(Nx+1,j,k)] = -grid[GI(Nx,j,k)];
-    END_FOR_TWO
-    FOR_GRIDZX
-        grid[GI(i,0   ,k)] = grid[GI(i,1 ,k)];
-        grid[GI(i,Ny+1,k)] = grid[GI(i,Ny,k)];
-    END_FOR_TWO
-    FOR_GRIDYX
-        grid[GI(i,j,0   )] = grid[GI(i,j,1 )];
-        grid[GI(i,j,Nz+1)] = grid[GI(i,j,Nz)];
-    END_FOR_TWO
-	SetBoundaryCorner();
-}
+	inline Double operator()(const Grid &g, int i, int j, int k, int ci, int cj, int ck) const
+		{ return g(ci,cj,ck); }
+};
 
-inline void Grid::SetBoundaryV()
+struct SignedDistBoundary
 {
-    FOR_GRIDZY
-        grid[GI(0   ,j,k)] = grid[GI(1 ,j,k)];
-        grid[GI(Nx+1,j,k)] = grid[GI(Nx,j,k)];
-    END_FOR_TWO
-    FOR_GRIDZX
-        grid[GI(i,0   ,k)] = -grid[GI(i,1 ,k)];
-        grid[GI(i,Ny+1,k)] = -grid[GI(i,Ny,k)];
-    END_FOR_TWO
-    FOR_GRIDYX
-        grid[GI(i,j,0   )] = grid[GI(i,j,1 )];
-        grid[GI(i,j,Nz+1)] = grid[GI(i,j,Nz)];
-    END_FOR_TWO
-	SetBoundaryCorner();
-}
+	inline Double operator()(const Grid &g, int i, int j, int k, int ci, int cj, int ck) const
+		{ return BOUNDARY_PHI; }
+};
 
-inline void Grid::SetBoundaryW()
+// the velocity component normal to the Axis faces is mirrored with the opposite sign across 
+// them, the other faces are Neumann
+template<int Axis>
+struct MirrorBoundary
 {
-    FOR_GRIDZY
-        grid[GI(0   ,j,k)] = grid[GI(1 ,j,k)];
-        grid[GI(Nx+1,j,k)] = grid[GI(Nx,j,k)];
-    END_FOR_TWO
-    FOR_GRIDZX
-        grid[GI(i,0   ,k)] = grid[GI(i,1 ,k)];
-        grid[GI(i,Ny+1,k)] = grid[GI(i,Ny,k)];
-    END_FOR_TWO
-    FOR_GRIDYX
-        grid[GI(i,j,0   )] = -grid[GI(i,j,1 )];
-        grid[GI(i,j,Nz+1)] = -grid[GI(i,j,Nz)];
-    END_FOR_TWO
-	SetBoundaryCorner();
-}
+	inline Double operator()(const Grid &g, int i, int j, int k, int ci, int cj, int ck) const
+	{
+		int n[3] = { i, j, k }, c[3] = { ci, cj, ck };
+		return n[Axis] != c[Axis] ? -g(ci,cj,ck) : g(ci,cj,ck);
+	}
+};
 
-inline void Grid::SetBoundarySignedDist()
+// fills the ghost cells of the slabs k = begin ... end-1, counted from the first ghost slab
+template<class Boundary>
+struct Grid::FillSlabs
 {
-    static Double phi = 3. * HH;
-    FOR_GRIDZY grid[GI(0,j,k)] = grid[GI(Nx+1,j,k)] = phi; END_FOR_TWO
-    FOR_GRIDZX grid[GI(i,0,k)] = grid[GI(i,Ny+1,k)] = phi; END_FOR_TWO
-    FOR_GRIDYX grid[GI(i,j,0)] = grid[GI(i,j,Nz+1)] = phi; END_FOR_TWO
-    for(int k=1 ; k<=Nz ; k++ ) {
-		grid[GI(0,0   ,k)] = grid[GI(Nx+1,0   ,k)] = phi;
-        grid[GI(0,Ny+1,k)] = grid[GI(Nx+1,Ny+1,k)] = phi;
-	}
-	for(int j=1 ; j<=Ny ; j++ ) {
-		grid[GI(0,j,0   )] = grid[GI(Nx+1,j,0   )] = phi;
-        grid[GI(0,j,Nz+1)] = grid[GI(Nx+1,j,Nz+1)] = phi;
-	}
-	for(int i=1 ; i<=Nx; i++ ) { 
-		grid[GI(i,0,0   )] = grid[GI(i,Ny+1,0   )] = phi;
-        grid[GI(i,0,Nz+1)] = grid[GI(i,Ny+1,Nz+1)] = phi;
+	Grid *grid;
+	const Boundary *boundary;
+	void operator()(int begin, int end) const
+	{
+		Grid &g = *grid;
+		int lo = 1 - g.ghost;
+		for(int k = begin + lo; k < end + lo; k++) {
+			int ck = Clamp(k, 1, g.Nz);
+			for(int j = lo; j <= g.Ny + g.ghost; j++) {
+				int cj = Clamp(j, 1, g.Ny);
+				bool inside = ck == k && cj == j;
+				for(int i = lo; i <= g.Nx + g.ghost; i++) {
+					if(inside && i == 1) i = g.Nx + 1;	// skip the interior of the row
+					g(i,j,k) = (*boundary)(g, i, j, k, Clamp(i, 1, g.Nx), cj, ck);
+				}
+			}
+		}
 	}
-    grid[GI(0   ,0   ,0   )] = grid[GI(Nx+1,0   ,0   )] = phi;
-	grid[GI(0   ,Ny+1,0   )] = grid[GI(0   ,0   ,Nz+1)] = phi;
-    grid[GI(Nx+1,Ny+1,0   )] = grid[GI(Nx+1,0   ,Nz+1)] = phi;
-    grid[GI(0   ,Ny+1,Nz+1)] = grid[GI(Nx+1,Ny+1,Nz+1)] = phi;
+};
+
+// sets every ghost cell (all ghost layers, faces, edges and corners) in one parallel sweep 
+// over z-slabs
+template<class Boundary>
+void Grid::FillBoundary(const Boundary &boundary)
+{
+	FillSlabs<Boundary> slabs;
+	slabs.grid = this;
+	slabs.boundary = &boundary;
+	ParallelFor(TaskPool::Shared(), 0, Nz + 2*ghost, 1, slabs);
 }
 
-inline void Grid::SetBoundaryCorner()
+inline void Grid::SetBoundaryDirichlet()	{ FillBoundary(DirichletBoundary()); }
+inline void Grid::SetBoundaryNeumann()		{ FillBoundary(NeumannBoundary()); }
+inline void Grid::SetBoundaryU()			{ FillBoundary(MirrorBoundary<0>()); }
+inline void Grid::SetBoundaryV()			{ FillBoundary(MirrorBoundary<1>()); }
+inline void Grid::SetBoundaryW()			{ FillBoundary(MirrorBoundary<2>()); }
+inline void Grid::SetBoundarySignedDist()	{ FillBoundary(SignedDistBoundary()); }
+
+// evaluates the cells begin ... end-1 of an expression
+template<class E>
+struct Grid::EvaluateCells
 {
-    for(int k=1 ; k<=Nz ; k++ ) {
-		grid[GI(0   ,0   ,k)] = 0.5 * (grid[GI(1   ,0 ,k)] + grid[GI(0   ,1   ,k)]);
-        grid[GI(Nx+1,0   ,k)] = 0.5 * (grid[GI(Nx  ,0 ,k)] + grid[GI(Nx+1,1   ,k)]);
-        grid[GI(0   ,Ny+1,k)] = 0.5 * (grid[GI(0   ,Ny,k)] + grid[GI(1   ,Ny+1,k)]);
-		grid[GI(Nx+1,Ny+1,k)] = 0.5 * (grid[GI(Nx+1,Ny,k)] + grid[GI(Nx  ,Ny+1,k)]);
-	}
-	for(int j=1 ; j<=Ny ; j++ ) {
-		grid[GI(0   ,j,0   )] = 0.5 * (grid[GI(1   ,j,0 )] + grid[GI(0   ,j,1   )]);
-        grid[GI(Nx+1,j,0   )] = 0.5 * (grid[GI(Nx  ,j,0 )] + grid[GI(Nx+1,j,1   )]);
-        grid[GI(0   ,j,Nz+1)] = 0.5 * (grid[GI(0   ,j,Nz)] + grid[GI(1   ,j,Nz+1)]);
-		grid[GI(Nx+1,j,Nz+1)] = 0.5 * (grid[GI(Nx+1,j,Nz)] + grid[GI(Nx  ,j,Nz+1)]);
-	}
-	for(int i=1 ; i<=Nx; i++ ) { 
-		grid[GI(i,0   ,0   )] = 0.5 * (grid[GI(i,1   ,0 )] + grid[GI(i,0   ,1   )]);
-        grid[GI(i,Ny+1,0   )] = 0.5 * (grid[GI(i,Ny  ,0 )] + grid[GI(i,Ny+1,1   )]);
-        grid[GI(i,0   ,Nz+1)] = 0.5 * (grid[GI(i,0   ,Nz)] + grid[GI(i,1   ,Nz+1)]);
-		grid[GI(i,Ny+1,Nz+1)] = 0.5 * (grid[GI(i,Ny+1,Nz)] + grid[GI(i,Ny  ,Nz+1)]);
+	Double *grid;
+	const E *e;
+	void operator()(int begin, int end) const
+	{
+		Double *g = grid;
+		const E &expr = *e;
+		for(int i = begin; i < end; i++) g[i] = expr[i];
 	}
-    grid[GI(0   ,0   ,0   )] = ONE_THIRD * (grid[GI(1   ,0   ,0   )] + 
-                                            grid[GI(0   ,1   ,0   )] + 
-                                            grid[GI(0   ,0   ,1   )] );
-	grid[GI(Nx+1,0   ,0   )] = ONE_THIRD * (grid[GI(Nx  ,0   ,0   )] +
-                                            grid[GI(Nx+1,1   ,0   )] +
-                                            grid[GI(Nx+1,0   ,1   )] );
-	grid[GI(0   ,Ny+1,0   )] = ONE_THIRD * (grid[GI(1   ,Ny+1,0   )] +
-                                            grid[GI(0   ,Ny  ,0   )] +
-                                            grid[GI(0   ,Ny+1,1   )] );
-	grid[GI(0   ,0   ,Nz+1)] = ONE_THIRD * (grid[GI(1   ,0   ,Nz+1)] +
-                                            grid[GI(0   ,1   ,Nz+1)] +
-                                            grid[GI(0   ,0   ,Nz  )] );
-    grid[GI(Nx+1,Ny+1,0   )] = ONE_THIRD * (grid[GI(Nx  ,Ny+1,0   )] +
-                                            grid[GI(Nx+1,Ny  ,0   )] +
-                                            grid[GI(Nx+1,Ny+1,1   )] );
-    grid[GI(Nx+1,0   ,Nz+1)] = ONE_THIRD * (grid[GI(Nx  ,0   ,Nz+1)] +
-                                            grid[GI(Nx+1,1   ,Nz+1)] +
-                                            grid[GI(Nx+1,0   ,Nz  )] );
-    grid[GI(0   ,Ny+1,Nz+1)] = ONE_THIRD * (grid[GI(1   ,Ny+1,Nz+1)] +
-                                            grid[GI(0   ,Ny  ,Nz+1)] +
-                                            grid[GI(0   ,Ny+1,Nz  )] );
-    grid[GI(Nx+1,Ny+1,Nz+1)] = ONE_THIRD * (grid[GI(Nx  ,Ny+1,Nz+1)] +
-                                            grid[GI(Nx+1,Ny  ,Nz+1)] +
-                                            grid[GI(Nx+1,Ny+1,Nz  )] );
+};
+
+template<class E>
+Grid& Grid::operator=(const GridExpr<E> &expr)
+{
+	assert(expr.size == size);
+	EvaluateCells<E> cells;
+	cells.grid = grid;
+	cells.e = &expr.e;
+	ParallelFor(TaskPool::Shared(), 0, size, GRID_CHUNK, cells);
+	return *this;
 }
 
+// Grids as operands of expressions
+#define GRID_OPERATOR(op, Op) \
+template<class B> \
+inline GridExpr< BinaryTerm<GridTerm,B,Op> > operator op(const Grid &a, const GridExpr<B> &b) \
+	{ return a.Expr() op b; } \
+template<class A> \
+inline GridExpr< BinaryTerm<A,GridTerm,Op> > operator op(const GridExpr<A> &a, const Grid &b) \
+	{ return a op b.Expr(); } \
+inline GridExpr< BinaryTerm<GridTerm,GridTerm,Op> > operator op(const Grid &a, const Grid &b) \
+	{ return a.Expr() op b.Expr(); } \
+inline GridExpr< BinaryTerm<GridTerm,ScalarTerm,Op> > operator op(const Grid &a, Double c) \
+	{ return a.Expr() op c; } \
+inline GridExpr< BinaryTerm<ScalarTerm,GridTerm,Op> > operator op(Double c, const Grid &b) \
+	{ return c op b.Expr(); }
+
+GRID_OPERATOR(+, AddOp)
+GRID_OPERATOR(-, SubOp)
+GRID_OPERATOR(*, MulOp)
+GRID_OPERATOR(/, DivOp)
+
+inline GridExpr< UnaryTerm<GridTerm,NegOp> > operator-(const Grid &a) { return -a.Expr(); }
+inline GridExpr< UnaryTerm<GridTerm,AbsOp> > Abs(const Grid &a) { return Abs(a.Expr()); }
+
 #endif
\ No newline at end of file
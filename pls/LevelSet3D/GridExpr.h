@@ -0,0 +1,197 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	GridExpr: Lazily evaluated arithmetic on Grids
+
+	Adding, subtracting, multiplying or dividing Grids (cell by cell) or a Grid and a number
+	does not compute anything, it returns a GridExpr that knows how to compute the value of
+	any one cell. Only assigning the expression to a Grid (=, += or -=) evaluates it, in a
+	single loop over the buffer that runs on the shared TaskPool. So
+		a = b + dt * c;
+	is one pass without temporary Grids. The Grids of an expression and the one it is
+	assigned to have to be of the same size and buffer width, since the cells are combined
+	position by position (buffer cells included, as in the in place operators of Grid).
+	Combining or assigning terms of different sizes fails an assert. A Grid may appear on both sides, since every cell only depends on the same cell.
+
+	Terms:
+	GridTerm		- the cells of a Grid
+	ScalarTerm		- a number, the same in every cell
+	BinaryTerm		- two terms combined with AddOp, SubOp, MulOp or DivOp
+	UnaryTerm		- a term with NegOp (unary -) or AbsOp (Abs) applied
+
+	Reductions:
+	Sum, Dot, MaxAbs	- sum of the cells, sum of the cell products of two expressions, and
+						  the largest magnitude. They are ParallelReduce over chunks of
+						  GRID_CHUNK cells, so the result does not depend on the number of
+						  threads. Grid::dot, normSqrd, norm and MaxAbs use them, so
+						  convergence checks like MaxAbs(a - b) need no copy of a
+*/
+
+#ifndef GRIDEXPR_H
+#define GRIDEXPR_H
+
+#include "main.h"
+#include "TaskPool.h"
+
+const int GRID_CHUNK = 16384;	// fewest cells per task of evaluations and reductions
+
+struct GridTerm
+{
+	const Double *p;
+	explicit GridTerm(const Double *cells) : p(cells) {}
+	inline Double operator[](int i) const { return p[i]; }
+};
+
+struct ScalarTerm
+{
+	Double c;
+	explicit ScalarTerm(Double value) : c(value) {}
+	inline Double operator[](int) const { return c; }
+};
+
+struct AddOp { static inline Double Apply(Double a, Double b) { return a + b; } };
+struct SubOp { static inline Double Apply(Double a, Double b) { return a - b; } };
+struct MulOp { static inline Double Apply(Double a, Double b) { return a * b; } };
+struct DivOp { static inline Double Apply(Double a, Double b) { return a / b; } };
+struct NegOp { static inline Double Apply(Double a) { return -a; } };
+struct AbsOp { static inline Double Apply(Double a) { return abs(a); } };
+
+template<class A, class B, class Op>
+struct BinaryTerm
+{
+	A a;
+	B b;
+	BinaryTerm(const A &ai, const B &bi) : a(ai), b(bi) {}
+	inline Double operator[](int i) const { return Op::Apply(a[i], b[i]); }
+};
+
+template<class A, class Op>
+struct UnaryTerm
+{
+	A a;
+	explicit UnaryTerm(const A &ai) : a(ai) {}
+	inline Double operator[](int i) const { return Op::Apply(a[i]); }
+};
+
+// a term and the number of cells it covers
+template<class E>
+struct GridExpr
+{
+	E e;
+	int size;
+	GridExpr(const E &ei, int s) : e(ei), size(s) {}
+	inline Double operator[](int i) const { return e[i]; }
+};
+
+template<class A, class B, class Op>
+inline GridExpr< BinaryTerm<A,B,Op> > Combine(const GridExpr<A> &a, const GridExpr<B> &b, Op)
+{
+	assert(a.size == b.size);
+	return GridExpr< BinaryTerm<A,B,Op> >(BinaryTerm<A,B,Op>(a.e, b.e), a.size);
+}
+template<class A, class Op>
+inline GridExpr< BinaryTerm<A,ScalarTerm,Op> > Combine(const GridExpr<A> &a, Double c, Op)
+	{ return GridExpr< BinaryTerm<A,ScalarTerm,Op> >(BinaryTerm<A,ScalarTerm,Op>(a.e, ScalarTerm(c)), a.size); }
+template<class B, class Op>
+inline GridExpr< BinaryTerm<ScalarTerm,B,Op> > Combine(Double c, const GridExpr<B> &b, Op)
+	{ return GridExpr< BinaryTerm<ScalarTerm,B,Op> >(BinaryTerm<ScalarTerm,B,Op>(ScalarTerm(c), b.e), b.size); }
+
+#define GRIDEXPR_OPERATOR(op, Op) \
+template<class A, class B> \
+inline GridExpr< BinaryTerm<A,B,Op> > operator op(const GridExpr<A> &a, const GridExpr<B> &b) \
+	{ return Combine(a, b, Op()); } \
+template<class A> \
+inline GridExpr< BinaryTerm<A,ScalarTerm,Op> > operator op(const GridExpr<A> &a, Double c) \
+	{ return Combine(a, c, Op()); } \
+template<class B> \
+inline GridExpr< BinaryTerm<ScalarTerm,B,Op> > operator op(Double c, const GridExpr<B> &b) \
+	{ return Combine(c, b, Op()); }
+
+GRIDEXPR_OPERATOR(+, AddOp)
+GRIDEXPR_OPERATOR(-, SubOp)
+GRIDEXPR_OPERATOR(*, MulOp)
+GRIDEXPR_OPERATOR(/, DivOp)
+
+template<class A>
+inline GridExpr< UnaryTerm<A,NegOp> > operator-(const GridExpr<A> &a)
+	{ return GridExpr< UnaryTerm<A,NegOp> >(UnaryTerm<A,NegOp>(a.e), a.size); }
+template<class A>
+inline GridExpr< UnaryTerm<A,AbsOp> > Abs(const GridExpr<A> &a)
+	{ return GridExpr< UnaryTerm<A,AbsOp> >(UnaryTerm<A,AbsOp>(a.e), a.size); }
+
+// partial sums and maxima of the cells begin ... end-1
+template<class E>
+struct GridSum
+{
+	const E *e;
+	Double operator()(int begin, int end) const
+	{
+		Double sum = 0;
+		for(int i = begin; i < end; i++) sum += (*e)[i];
+		return sum;
+	}
+	static Double Join(Double a, Double b) { return a + b; }
+};
+
+template<class E>
+struct GridMaxAbs
+{
+	const E *e;
+	Double operator()(int begin, int end) const
+	{
+		Double m = 0;
+		for(int i = begin; i < end; i++) m = max(m, Double(abs((*e)[i])));
+		return m;
+	}
+	static Double Join(Double a, Double b) { return max(a, b); }
+};
+
+template<class E>
+Double Sum(const GridExpr<E> &expr)
+{
+	GridSum<E> body;
+	body.e = &expr.e;
+	return ParallelReduce(TaskPool::Shared(), 0, expr.size, GRID_CHUNK, body, Double(0),
+						  &GridSum<E>::Join);
+}
+
+template<class A, class B>
+inline Double Dot(const GridExpr<A> &a, const GridExpr<B> &b) { return Sum(a * b); }
+
+template<class E>
+Double MaxAbs(const GridExpr<E> &expr)
+{
+	GridMaxAbs<E> body;
+	body.e = &expr.e;
+	return ParallelReduce(TaskPool::Shared(), 0, expr.size, GRID_CHUNK, body, Double(0),
+						  &GridMaxAbs<E>::Join);
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	GridView: A Grid shaped window on memory the library does not own
+
+	The view neither allocates nor frees anything. It addresses the cells of a volume of
+	nx x ny x nz cells (plus ghost buffer cells on each side) in some caller's memory,
+	for instance an array of the host application or a memory mapped file, with the same
+	(i,j,k) as a Grid: the cells go from 1-ghost to N+ghost, and (1,1,1) is the first
+	cell that is not a buffer cell. ghost may be 0 for arrays without a buffer.
+
+	The dense constructor takes x as the fastest axis with no padding, which is the
+	layout of the arrays given to the Grid(nx,ny,nz,val) constructor (ghost 0) and of a
+	Grid buffer (ghost = Grid::GetGhost()). The strided one takes the distance between
+	neighbors along each axis and the position of the lowest cell, (1-ghost,1-ghost,1-ghost),
+	so that it can also look at part of a larger volume or at a padded one.
+
+	Fits			- whether the memory has exactly the layout of the buffer of the grid, in
+					  which case the grid can work in it directly (Grid::Adopt,
+					  LevelSet::Attach)
+*/
+
+#ifndef GRIDVIEW_H
+#define GRIDVIEW_H
+
+#include "main.h"
+#include "Grid.h"
+
+class GridView
+{
+public:
+	GridView(int nx, int ny, int nz, Double *cells, int g = 0)
+		: Nx(nx), Ny(ny), Nz(nz), ghost(g), data(cells)
+	{
+		si = 1;
+		sj = Nx + 2*ghost;
+		sk = sj * (Ny + 2*ghost);
+		origin = (ghost - 1) * (si + sj + sk);
+	}
+	GridView(int nx, int ny, int nz, Double *lowest, int stepI, int stepJ, int stepK, int g = 0)
+		: Nx(nx), Ny(ny), Nz(nz), ghost(g), si(stepI), sj(stepJ), sk(stepK), data(lowest)
+		{ origin = (ghost - 1) * (si + sj + sk); }
+
+	inline Double& operator() (int i, int j, int k) { return data[i*si + j*sj + k*sk + origin]; }
+	inline const Double& operator() (int i, int j, int k) const
+		{ return data[i*si + j*sj + k*sk + origin]; }
+
+	inline int GetNx() const { return Nx; }
+	inline int GetNy() const { return Ny; }
+	inline int GetNz() const { return Nz; }
+	inline int GetGhost() const { return ghost; }
+	// the lowest cell, (1-ghost,1-ghost,1-ghost)
+	inline Double* Data() const { return data; }
+
+	bool Fits(const Grid &g) const
+	{
+		int dj, dk;
+		g.GetStrides(dj, dk);
+		return Nx == g.GetNx() && Ny == g.GetNy() && Nz == g.GetNz() &&
+			   ghost == g.GetGhost() && si == 1 && sj == dj && sk == dk;
+	}
+
+private:
+	int Nx, Ny, Nz, ghost;
+	int si, sj, sk;		// distance between neighbors along x, y and z
+	int origin;			// position of (0,0,0) relative to data
+	Double *data;
+};
+
+#endif
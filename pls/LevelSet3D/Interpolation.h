@@ -0,0 +1,250 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+/*
+	Interpolation: Policies for sampling a Grid between its nodes
+
+	Interpolation names the policies at runtime (INTERP_LINEAR, ...). The kernels that 
+	sample phi (advection, Fix, Resample, Reseed, meshing) are templates on the policy, and
+	their non-template form switches on the Interpolation once per pass. Each policy has
+	the same static functions:
+
+	Sample	- The value at the offsets (a,b,c) from the lower corner (i,j,k) of a cell, at 
+			  the offsets from the node with index base (Grid::Index), or at the position 
+			  (x,y,z) in grid coordinates. The last form can also return the gradient in 
+			  grid units (multiply by 1/h for world units)
+
+	LinearInterpolation		- Trilinear interpolation of the 8 corners of the cell
+	CubicInterpolation		- Monotonic cubic interpolation (MCerp) over the 4x4x4 surrounding
+							  nodes. The gradient is a central difference over half a cell
+	CatmullRomInterpolation	- Tensor product Catmull-Rom over the 4x4x4 surrounding nodes.
+							  The four weights per axis are computed once per point, so it
+							  is close to the cubic in accuracy at a fraction of the cost. It
+							  is not monotonic and may overshoot next to sharp features. The
+							  gradient is the exact gradient of the interpolant
+
+	The nodes outside the grid are clamped to its boundary. The cubic policies read one node 
+	below and two above the cell, so on grids with a buffer of 2 or more cells 
+	(Grid::GetGhost) they skip the clamping altogether.
+*/
+
+#ifndef INTERPOLATION_H
+#define INTERPOLATION_H
+
+#include "main.h"
+#include "Grid.h"
+
+enum Interpolation { INTERP_LINEAR, INTERP_CUBIC, INTERP_CATMULL_ROM };
+const int INTERPOLATIONS = 3;
+
+inline const char* InterpolationName(Interpolation interp)
+{
+	static const char *names[INTERPOLATIONS] = { "linear", "cubic", "catmull-rom" };
+	return names[interp];
+}
+
+// the lower corner (i,j,k) of the cell sampled for the position (x,y,z). Positions on or 
+// just past the upper buffer face (particles are kept up to N+1) are taken in the last cell,
+// so the stencils of the samplers stay inside the buffer
+inline void SampleCell(const Grid &phi, Double x, Double y, Double z, int &i, int &j, int &k)
+{
+	i = Clamp(int(x), 0, phi.GetNx());
+	j = Clamp(int(y), 0, phi.GetNy());
+	k = Clamp(int(z), 0, phi.GetNz());
+}
+
+struct LinearInterpolation
+{
+	static inline Double Sample(const Grid &phi, int base, Double a, Double b, Double c)
+	{
+		int dj, dk;
+		phi.GetStrides(dj, dk);
+		const Double *p = &phi[base];
+		return Lerp(c, 
+					Lerp(b, Lerp(a, p[0],  p[1]),    Lerp(a, p[dj],    p[dj+1])),
+					Lerp(b, Lerp(a, p[dk], p[dk+1]), Lerp(a, p[dj+dk], p[dj+dk+1])) );
+	}
+	static inline Double Sample(const Grid &phi, int i, int j, int k, Double a, Double b, Double c)
+		{ return Sample(phi, phi.Index(i,j,k), a, b, c); }
+	static inline Double Sample(const Grid &phi, Double x, Double y, Double z)
+	{
+		int i, j, k;
+		SampleCell(phi, x, y, z, i, j, k);
+		return Sample(phi, phi.Index(i,j,k), x-i, y-j, z-k);
+	}
+	static inline Double Sample(const Grid &phi, Double x, Double y, Double z, 
+								Double &gx, Double &gy, Double &gz)
+	{
+		int i, j, k;
+		SampleCell(phi, x, y, z, i, j, k);
+		Double a = x-i, b = y-j, c = z-k;
+		int dj, dk;
+		phi.GetStrides(dj, dk);
+		const Double *p = &phi[phi.Index(i,j,k)];
+		Double c000 = p[0],     c100 = p[1],       c010 = p[dj],    c110 = p[dj+1];
+		Double c001 = p[dk],    c101 = p[dk+1],    c011 = p[dj+dk], c111 = p[dj+dk+1];
+		gx = Lerp(c, Lerp(b, c100-c000, c110-c010), Lerp(b, c101-c001, c111-c011));
+		gy = Lerp(c, Lerp(a, c010-c000, c110-c100), Lerp(a, c011-c001, c111-c101));
+		gz = Lerp(b, Lerp(a, c001-c000, c101-c100), Lerp(a, c011-c010, c111-c110));
+		return Lerp(c, Lerp(b, Lerp(a, c000, c100), Lerp(a, c010, c110)),
+					   Lerp(b, Lerp(a, c001, c101), Lerp(a, c011, c111)) );
+	}
+};
+
+struct CubicInterpolation
+{
+	static inline Double Sample(const Grid &phi, int i, int j, int k, Double a, Double b, Double c)
+	{
+		int is[4] = { i-1, i, i+1, i+2 }, js[4] = { j-1, j, j+1, j+2 }, ks[4] = { k-1, k, k+1, k+2 };
+		if(phi.GetGhost() < 2) {
+			is[0] = max(is[0], 0); is[3] = min(is[3], phi.GetNx()+1);
+			js[0] = max(js[0], 0); js[3] = min(js[3], phi.GetNy()+1);
+			ks[0] = max(ks[0], 0); ks[3] = min(ks[3], phi.GetNz()+1);
+		}
+		assert(is[0] >= 1-phi.GetGhost() && is[3] <= phi.GetNx()+phi.GetGhost() &&
+			   js[0] >= 1-phi.GetGhost() && js[3] <= phi.GetNy()+phi.GetGhost() &&
+			   ks[0] >= 1-phi.GetGhost() && ks[3] <= phi.GetNz()+phi.GetGhost());
+		Double planes[4], rows[4];
+		for(int n = 0; n < 4; n++) {
+			for(int m = 0; m < 4; m++)
+				rows[m] = MCerp(b, phi(is[m],js[0],ks[n]), phi(is[m],js[1],ks[n]), 
+								   phi(is[m],js[2],ks[n]), phi(is[m],js[3],ks[n]));
+			planes[n] = MCerp(a, rows[0], rows[1], rows[2], rows[3]);
+		}
+		return MCerp(c, planes[0], planes[1], planes[2], planes[3]);
+	}
+	static inline Double Sample(const Grid &phi, int base, Double a, Double b, Double c)
+	{
+		int i, j, k;
+		phi.Coordinates(base, i, j, k);
+		return Sample(phi, i, j, k, a, b, c);
+	}
+	static inline Double Sample(const Grid &phi, Double x, Double y, Double z)
+	{
+		int i, j, k;
+		SampleCell(phi, x, y, z, i, j, k);
+		return Sample(phi, i, j, k, x-i, y-j, z-k);
+	}
+	static inline Double Sample(const Grid &phi, Double x, Double y, Double z, 
+								Double &gx, Double &gy, Double &gz)
+	{
+		gx = (Sample(phi, x+0.25, y, z) - Sample(phi, x-0.25, y, z)) * 2.;
+		gy = (Sample(phi, x, y+0.25, z) - Sample(phi, x, y-0.25, z)) * 2.;
+		gz = (Sample(phi, x, y, z+0.25) - Sample(phi, x, y, z-0.25)) * 2.;
+		return Sample(phi, x, y, z);
+	}
+};
+
+struct CatmullRomInterpolation
+{
+	// indices and weights of the four nodes around i+t along one axis of n cells with a 
+	// buffer of ghost cells. With a 1 cell buffer the indices are clamped to it
+	static inline void Weights(int i, Double t, int n, int ghost, int *index, Double *w)
+	{
+		Double t2 = t * t, t3 = t2 * t;
+		bool clamp = ghost < 2;
+		index[0] = clamp && i == 0 ? 0 : i - 1;
+		index[1] = i;
+		index[2] = i + 1;
+		index[3] = clamp && i + 2 > n + 1 ? n + 1 : i + 2;
+		assert(index[0] >= 1-ghost && index[3] <= n+ghost);
+		w[0] = -0.5 * t3 + t2 - 0.5 * t;
+		w[1] =  1.5 * t3 - 2.5 * t2 + 1.;
+		w[2] = -1.5 * t3 + 2. * t2 + 0.5 * t;
+		w[3] =  0.5 * t3 - 0.5 * t2;
+	}
+	// derivatives of the weights
+	static inline void Derivatives(Double t, Double *dw)
+	{
+		Double t2 = t * t;
+		dw[0] = -1.5 * t2 + 2. * t - 0.5;
+		dw[1] =  4.5 * t2 - 5. * t;
+		dw[2] = -4.5 * t2 + 4. * t + 0.5;
+		dw[3] =  1.5 * t2 - t;
+	}
+	static inline Double Sample(const Grid &phi, int i, int j, int k, Double a, Double b, Double c)
+	{
+		int ix[4], iy[4], iz[4];
+		Double wx[4], wy[4], wz[4];
+		Weights(i, a, phi.GetNx(), phi.GetGhost(), ix, wx);
+		Weights(j, b, phi.GetNy(), phi.GetGhost(), iy, wy);
+		Weights(k, c, phi.GetNz(), phi.GetGhost(), iz, wz);
+		Double value = 0;
+		for(int n = 0; n < 4; n++) {
+			Double plane = 0;
+			for(int m = 0; m < 4; m++) {
+				const Double *row = &phi[phi.Index(0, iy[m], iz[n])];
+				plane += wy[m] * (wx[0]*row[ix[0]] + wx[1]*row[ix[1]] + wx[2]*row[ix[2]] + wx[3]*row[ix[3]]);
+			}
+			value += wz[n] * plane;
+		}
+		return value;
+	}
+	static inline Double Sample(const Grid &phi, int base, Double a, Double b, Double c)
+	{
+		int i, j, k;
+		phi.Coordinates(base, i, j, k);
+		return Sample(phi, i, j, k, a, b, c);
+	}
+	static inline Double Sample(const Grid &phi, Double x, Double y, Double z)
+	{
+		int i, j, k;
+		SampleCell(phi, x, y, z, i, j, k);
+		return Sample(phi, i, j, k, x-i, y-j, z-k);
+	}
+	static inline Double Sample(const Grid &phi, Double x, Double y, Double z, 
+								Double &gx, Double &gy, Double &gz)
+	{
+		int i, j, k;
+		SampleCell(phi, x, y, z, i, j, k);
+		int ix[4], iy[4], iz[4];
+		Double wx[4], wy[4], wz[4], dwx[4], dwy[4], dwz[4];
+		Weights(i, x-i, phi.GetNx(), phi.GetGhost(), ix, wx);
+		Weights(j, y-j, phi.GetNy(), phi.GetGhost(), iy, wy);
+		Weights(k, z-k, phi.GetNz(), phi.GetGhost(), iz, wz);
+		Derivatives(x-i, dwx);
+		Derivatives(y-j, dwy);
+		Derivatives(z-k, dwz);
+		Double value = 0;
+		gx = gy = gz = 0;
+		for(int n = 0; n < 4; n++) {
+			for(int m = 0; m < 4; m++) {
+				const Double *row = &phi[phi.Index(0, iy[m], iz[n])];
+				Double r  = wx[0]*row[ix[0]]  + wx[1]*row[ix[1]]  + wx[2]*row[ix[2]]  + wx[3]*row[ix[3]];
+				Double dr = dwx[0]*row[ix[0]] + dwx[1]*row[ix[1]] + dwx[2]*row[ix[2]] + dwx[3]*row[ix[3]];
+				value += wy[m] * wz[n] * r;
+				gx += wy[m] * wz[n] * dr;
+				gy += dwy[m] * wz[n] * r;
+				gz += wy[m] * dwz[n] * r;
+			}
+		}
+		return value;
+	}
+};
+
+#endif
@@ -1,28 +1,178 @@
 #include "LevelSet.h"
 #include "ParticleSet.h"
 #include "Particle.h"
+#include "TaskPool.h"
 
-void LevelSet::Update(const Velocity& grid, const Double &dt)
+// semi lagrangian steps for the slabs k = begin ... end-1
+template<class Interp>
+struct LevelSet::AdvectSlabs
+{
+	LevelSet *levelSet;
+	const Velocity *grid;
+	Double dt;
+	void operator()(int begin, int end) const
+	{
+		for(int k = begin; k < end; k++)
+			for(int j = 1; j <= NY; j++)
+				for(int i = 1; i <= NX; i++)
+					levelSet->SemiLagrangianStep<Interp>(i,j,k,*grid,dt);
+	}
+};
+
+// the same as AdvectSlabs, using the cached backtraces
+template<class Interp>
+struct LevelSet::AdvectCachedSlabs
+{
+	LevelSet *levelSet;
+	void operator()(int begin, int end) const
+	{
+		const Grid &phi = levelSet->gridPhi;
+		Grid &tmp = levelSet->gridTmp;
+		for(int k = begin; k < end; k++)
+			for(int j = 1; j <= NY; j++) {
+				const Backtrace *bt = &levelSet->backtraces[((k-1)*NY + (j-1))*NX];
+				for(int i = 1; i <= NX; i++, bt++) {
+					int index = phi.Index(i,j,k);
+					if(phi[index] > SEMILAGRA_LIMIT) {
+						tmp[index] = phi[index];
+						continue;
+					}
+					tmp[index] = Interp::Sample(phi, bt->base, bt->a, bt->b, bt->c);
+				}
+			}
+	}
+};
+
+// fills the cached backtraces for the slabs k = begin ... end-1
+struct LevelSet::BacktraceSlabs
+{
+	LevelSet *levelSet;
+	const Velocity *grid;
+	Double dt;
+	void operator()(int begin, int end) const
+	{
+		int r,s,t;
+		Double a,b,c;
+		for(int k = begin; k < end; k++)
+			for(int j = 1; j <= NY; j++) {
+				Backtrace *bt = &levelSet->backtraces[((k-1)*NY + (j-1))*NX];
+				for(int i = 1; i <= NX; i++, bt++) {
+					levelSet->TraceBack(i,j,k,*grid,dt,r,s,t,a,b,c);
+					bt->base = levelSet->gridPhi.Index(r,s,t);
+					bt->a = float(a);
+					bt->b = float(b);
+					bt->c = float(c);
+				}
+			}
+	}
+};
+
+// merges gridPos and gridNeg into gridPhi for the touched nodes begin ... end-1 and counts
+// the ones that changed
+struct LevelSet::MergeNodes
+{
+	LevelSet *levelSet;
+	FixStatistics operator()(int begin, int end) const
+	{
+		FixStatistics stats;
+		for(int n = begin; n < end; n++) {
+			int index = levelSet->touched[n];
+			Double phiPos = levelSet->gridPos[index], phiNeg = levelSet->gridNeg[index];
+			Double merged = abs(phiPos) < abs(phiNeg) ? phiPos : phiNeg;
+			if(merged != levelSet->gridPhi[index]) stats.corrected++;
+			levelSet->gridPhi[index] = merged;
+			levelSet->touchedFlags[index] = 0;
+		}
+		return stats;
+	}
+};
+
+// samples the level set at the particles begin ... end-1 of an array
+template<class Interp>
+struct LevelSet::SampleParticles
+{
+	const LevelSet *levelSet;
+	const CompactParticle *particles;
+	Double *phi;
+	void operator()(int begin, int end) const
+	{
+		Double x[SAMPLE_BATCH], y[SAMPLE_BATCH], z[SAMPLE_BATCH];
+		Vector pos;
+		for(int first = begin; first < end; first += SAMPLE_BATCH) {
+			int n = min(SAMPLE_BATCH, end - first);
+			for(int p = 0; p < n; p++) {
+				particles[first+p].GetPosition(pos);
+				x[p] = pos[0]; y[p] = pos[1]; z[p] = pos[2];
+			}
+			levelSet->Sample<Interp>(x, y, z, n, phi + first);
+		}
+	}
+};
+
+// counts the band cells and the deficient ones of the slabs k = begin ... end-1
+struct LevelSet::BandSlabs
+{
+	const LevelSet *levelSet;
+	const ParticleSet *particleSet;
+	FixStatistics operator()(int begin, int end) const
+	{
+		FixStatistics stats;
+		const Grid &phi = levelSet->gridPhi;
+		for(int k = begin; k < end; k++)
+			for(int j = 1; j <= NY; j++)
+				for(int i = 1; i <= NX; i++) {
+					int target = particleSet->Target(*levelSet, i, j, k);
+					if(target == 0) continue;
+					stats.band++;
+					if(2 * levelSet->cellParticles[phi.Index(i,j,k)] < target) stats.deficient++;
+				}
+		return stats;
+	}
+};
+
+void LevelSet::Update(const Velocity& grid, const Double &dt, Interpolation interp)
+{
+	// Advect writes gridTmp and swaps it in, so an attached gridPhi is advected from a copy
+	if(attached != NULL && &gridPhi[0] == attached) {
+		gridTmp = gridPhi.Expr();
+		gridPhi.Swap(gridTmp);
+	}
+	switch(interp) {
+	case INTERP_CUBIC:		 Advect<CubicInterpolation>(grid, dt); break;
+	case INTERP_CATMULL_ROM: Advect<CatmullRomInterpolation>(grid, dt); break;
+	default:				 Advect<LinearInterpolation>(grid, dt); break;
+	}
+}
+
+template<class Interp>
+void LevelSet::Advect(const Velocity& grid, const Double &dt)
 {
 	//First Order time integration
-	FOR_LS
-		SemiLagrangianStep(i,j,k,grid,dt);
-	END_FOR_THREE
+	if(grid.Steady()) {
+		CacheBacktraces(grid, dt);
+		AdvectCachedSlabs<Interp> advect;
+		advect.levelSet = this;
+		ParallelFor(TaskPool::Shared(), 1, NZ+1, 1, advect);
+	}
+	else {
+		AdvectSlabs<Interp> advect;
+		advect.levelSet = this;
+		advect.grid = &grid;
+		advect.dt = dt;
+		ParallelFor(TaskPool::Shared(), 1, NZ+1, 1, advect);
+	}
 
-	swap(gridPhi, gridTmp);
+	gridPhi.Swap(gridTmp);
 	gridPhi.SetBoundarySignedDist();
 }
 
-void LevelSet::SemiLagrangianStep(int x, int y, int z, const Velocity &grid, const Double &dt)
+// lower corner (r,s,t) of the cell the value of (x,y,z) comes from, and the weights a,b,c of 
+// its upper corners
+inline void LevelSet::TraceBack(int x, int y, int z, const Velocity &grid, const Double &dt,
+								int &r, int &s, int &t, Double &a, Double &b, Double &c) const
 {
-    static int r,s,t;
-    static Double a,b,c;
-	if(gridPhi(x,y,z) > SEMILAGRA_LIMIT) {
-		gridTmp(x,y,z) = gridPhi(x,y,z);
-		return;
-	}
-	static Vector u; //obtain from velocity grid
-	grid.GetVelocity(Vector(x,y,z), u);
+	Vector u; //obtain from velocity grid
+	grid.GetCellVelocity(x,y,z,u);
 
     r = x - int(ceil(u[0] * dt * hInv));
 	s = y - int(ceil(u[1] * dt * hInv));
@@ -36,62 +186,213 @@ void LevelSet::SemiLagrangianStep(int x, int y, int z, const Velocity &grid, con
 	a = (Double(x - r) * h - u[0] * dt) * hInv;
 	b = (Double(y - s) * h - u[1] * dt) * hInv;
     c = (Double(z - t) * h - u[2] * dt) * hInv;
+}
+
+void LevelSet::CacheBacktraces(const Velocity &grid, const Double &dt)
+{
+	if(cachedGrid == &grid && cachedVersion == grid.Version() && cachedDt == dt) return;
+
+	backtraces.resize(NX * NY * NZ);
+	BacktraceSlabs trace;
+	trace.levelSet = this;
+	trace.grid = &grid;
+	trace.dt = dt;
+	ParallelFor(TaskPool::Shared(), 1, NZ+1, 1, trace);
+
+	cachedGrid = &grid;
+	cachedVersion = grid.Version();
+	cachedDt = dt;
+}
+
+template<class Interp>
+void LevelSet::SemiLagrangianStep(int x, int y, int z, const Velocity &grid, const Double &dt)
+{
+    int r,s,t;
+    Double a,b,c;
+	if(gridPhi(x,y,z) > SEMILAGRA_LIMIT) {
+		gridTmp(x,y,z) = gridPhi(x,y,z);
+		return;
+	}
+	TraceBack(x,y,z,grid,dt,r,s,t,a,b,c);
+	gridTmp(x,y,z) = Interp::Sample(gridPhi, r, s, t, a, b, c);
+}
+
+void LevelSet::Initialize(const Grid &init)
+{
+	if(init.GetGhost() == gridPhi.GetGhost()) {
+		gridPhi = init;
+		return;
+	}
+	gridPhi.SetBoundarySignedDist();
+	int ghost = min(init.GetGhost(), gridPhi.GetGhost());
+	for(int k = 1-ghost; k <= Nz+ghost; k++)
+		for(int j = 1-ghost; j <= Ny+ghost; j++)
+			for(int i = 1-ghost; i <= Nx+ghost; i++)
+				gridPhi(i,j,k) = init(i,j,k);
+}
+
+void LevelSet::Initialize(const GridView &init)
+{
+	if(init.GetNx() != Nx || init.GetNy() != Ny || init.GetNz() != Nz) {
+		cerr << "LevelSet::Initialize: the view is " << init.GetNx() << "x" << init.GetNy() 
+			 << "x" << init.GetNz() << " cells, the level set " << Nx << "x" << Ny << "x" << Nz << endl;
+		return;
+	}
+	gridPhi.SetBoundarySignedDist();
+	int ghost = min(init.GetGhost(), gridPhi.GetGhost());
+	for(int k = 1-ghost; k <= Nz+ghost; k++)
+		for(int j = 1-ghost; j <= Ny+ghost; j++)
+			for(int i = 1-ghost; i <= Nx+ghost; i++)
+				gridPhi(i,j,k) = init(i,j,k);
+}
 
-	gridTmp(x,y,z) =    a  *    b  *    c  * gridPhi(r+1, s+1, t+1) +
-				     (1-a) *    b  *    c  * gridPhi(r  , s+1, t+1) +
-				        a  * (1-b) *    c  * gridPhi(r+1, s  , t+1) +
-                        a  *    b  * (1-c) * gridPhi(r+1, s+1, t  ) +
-                     (1-a) * (1-b) *    c  * gridPhi(r  , s  , t+1) +
-                     (1-a) *    b  * (1-c) * gridPhi(r  , s+1, t  ) +
-                        a  * (1-b) * (1-c) * gridPhi(r+1, s  , t  ) +
-				     (1-a) * (1-b) * (1-c) * gridPhi(r  , s  , t  );
+bool LevelSet::Attach(const GridView &phi)
+{
+	if(!phi.Fits(gridPhi)) {
+		cerr << "LevelSet::Attach: the memory does not have the layout of the level set grid" << endl;
+		return false;
+	}
+	gridPhi.Adopt(phi.Data(), NULL);
+	attached = phi.Data();
+	gridPhi.SetBoundarySignedDist();
+	return true;
 }
 
 void LevelSet::ReInitialize(FastMarch &gridFM) {
-    gridFM.Reinitialize(gridPhi);
-    gridPhi.SetBoundarySignedDist();
+    gridFM.Reinitialize(gridPhi, BOUNDARY_PHI);	// also does gridPhi.SetBoundarySignedDist()
 }
     
-void LevelSet::Fix(const ParticleSet& particleSet)
+FixStatistics LevelSet::Fix(const ParticleSet& particleSet, Interpolation interp)
+{
+	switch(interp) {
+	case INTERP_CUBIC:		 return Fix<CubicInterpolation>(particleSet);
+	case INTERP_CATMULL_ROM: return Fix<CatmullRomInterpolation>(particleSet);
+	default:				 return Fix<LinearInterpolation>(particleSet);
+	}
+}
+
+template<class Interp>
+FixStatistics LevelSet::Fix(const ParticleSet& particleSet)
 {	
-	static ParticleSet::cIterator pit, end;
-	static Vector pos;
-    static Double phi;
-    static int sign;
-
-    end = particleSet.end();
-	gridPos = gridPhi;
-	gridNeg = gridPhi;
-	for(pit = particleSet.begin(); pit != end; ++pit)
-	{
-		Particle& particle = *(*pit);
-		particle.GetPosition(pos);
-        phi = SAMPLEPHI(pos);
-		sign = particle.Sign();
+	int n = particleSet.Count();
+	const CompactParticle *particles = particleSet.Data();
+	int escaped = 0;
 
-		if(phi * sign < 0.)
+	SampleAt<Interp>(particles, n);
+	cellParticles.assign(size, 0);
+	for(int p = 0; p < n; p++) {
+		const CompactParticle &particle = particles[p];
+		int i, j, k;
+		particle.GetCell(i, j, k);
+		cellParticles[gridPhi.Index(i,j,k)]++;
+		if(particlePhi[p] * particle.Sign() < 0.)
 		{
+			escaped++;
 			//particle has crossed the boundary
-			if(sign < 0.) FixNeg(particle, int(pos[0]), int(pos[1]), int(pos[2]));
-			else		  FixPos(particle, int(pos[0]), int(pos[1]), int(pos[2]));
+			if(particle.Sign() < 0.) FixNeg(particle.Decode(), i, j, k);
+			else					 FixPos(particle.Decode(), i, j, k);
 		}
 	}
-	//Merge gridPos & gridNeg
-	static Double phiPos, phiNeg;
-	FOR_ALL_LS
-		phiPos = gridPos(i,j,k); phiNeg = gridNeg(i,j,k);
-		gridPhi(i,j,k) = abs(phiPos) < abs(phiNeg) ? phiPos : phiNeg;
-	END_FOR_THREE
+	FixStatistics stats = Merge(particleSet);
+	stats.escaped = escaped;
+	return stats;
+}
+
+FixStatistics LevelSet::FixAndResample(ParticleSet& particleSet, Interpolation interp)
+{
+	switch(interp) {
+	case INTERP_CUBIC:		 return FixAndResample<CubicInterpolation>(particleSet);
+	case INTERP_CATMULL_ROM: return FixAndResample<CatmullRomInterpolation>(particleSet);
+	default:				 return FixAndResample<LinearInterpolation>(particleSet);
+	}
+}
+
+template<class Interp>
+FixStatistics LevelSet::FixAndResample(ParticleSet& particleSet)
+{	
+	int n = particleSet.Count();
+	CompactParticle *particles = particleSet.Data();
+	int escaped = 0, deleted = 0;
+
+	SampleAt<Interp>(particles, n);
+	cellParticles.assign(size, 0);
+	particleKeep.resize(n);
+	for(int p = 0; p < n; p++) {
+		CompactParticle &particle = particles[p];
+		int i, j, k;
+		particle.GetCell(i, j, k);
+		if(particlePhi[p] * particle.Sign() < 0.)
+		{
+			escaped++;
+			//particle has crossed the boundary, correct with the radius it had so far
+			if(particle.Sign() < 0.) FixNeg(particle.Decode(), i, j, k);
+			else					 FixPos(particle.Decode(), i, j, k);
+		}
+		particleKeep[p] = particle.SetRadius(particlePhi[p], hInv);
+		if(particleKeep[p]) cellParticles[gridPhi.Index(i,j,k)]++;
+		else deleted++;
+	}
+	if(deleted > 0) particleSet.Compact(&particleKeep[0]);
+	FixStatistics stats = Merge(particleSet);
+	stats.escaped = escaped;
+	stats.deleted = deleted;
+	return stats;
+}
+
+// samples gridPhi at the particles into particlePhi, in parallel chunks
+template<class Interp>
+void LevelSet::SampleAt(const CompactParticle *particles, int n)
+{
+	particlePhi.resize(n);
+	if(n == 0) return;
+	SampleParticles<Interp> sample;
+	sample.levelSet = this;
+	sample.particles = particles;
+	sample.phi = &particlePhi[0];
+	ParallelFor(TaskPool::Shared(), 0, n, PARTICLE_CHUNK, sample);
+}
+
+// merges gridPos & gridNeg into gridPhi at the touched nodes and counts the band using 
+// cellParticles
+FixStatistics LevelSet::Merge(const ParticleSet& particleSet)
+{
+	MergeNodes merge;
+	merge.levelSet = this;
+	FixStatistics stats = ParallelReduce(TaskPool::Shared(), 0, int(touched.size()), 4096, merge, 
+										 FixStatistics(), FixStatistics::Join);
+	touched.clear();
+
+	BandSlabs band;
+	band.levelSet = this;
+	band.particleSet = &particleSet;
+	stats = FixStatistics::Join(stats, ParallelReduce(TaskPool::Shared(), 1, NZ+1, 1, band, 
+													  FixStatistics(), FixStatistics::Join));
+	stats.particles = particleSet.Count();
+	return stats;
+}
+
+// the index of node (i,j,k). The first time a Fix touches a node its gridPos and gridNeg are
+// set to gridPhi and it is listed in touched
+inline int LevelSet::Touch(int i, int j, int k)
+{
+	int index = gridPhi.Index(i,j,k);
+	if(!touchedFlags[index]) {
+		touchedFlags[index] = 1;
+		gridPos[index] = gridNeg[index] = gridPhi[index];
+		touched.push_back(index);
+	}
+	return index;
 }
 
 inline void LevelSet::FixNeg(const Particle &particle, int i, int j, int k)
 {
-	static Double particlePhi;
+	Double particlePhi;
 	for(int dx = 0; dx < 2; dx++) {
 		for(int dy = 0; dy < 2; dy++) {
             for(int dz = 0; dz < 2; dz++) {
 			    particlePhi = particle.phi(Vector(i+dx,j+dy,k+dz), h);
-                gridNeg(i+dx,j+dy,k+dz) = min(particlePhi, gridNeg(i+dx,j+dy,k+dz));
+				int index = Touch(i+dx,j+dy,k+dz);
+                gridNeg[index] = min(particlePhi, gridNeg[index]);
             }
 		}
 	}
@@ -99,116 +400,53 @@ inline void LevelSet::FixNeg(const Particle &particle, int i, int j, int k)
 
 inline void LevelSet::FixPos(const Particle &particle, int i, int j, int k)
 {
-	static Double particlePhi;
+	Double particlePhi;
 	for(int dx = 0; dx < 2; dx++) {
 		for(int dy = 0; dy < 2; dy++) {
             for(int dz = 0; dz < 2; dz++) {
 			    particlePhi = particle.phi(Vector(i+dx,j+dy,k+dz), h);
-                gridPos(i+dx,j+dy,k+dz) = max(particlePhi, gridPos(i+dx,j+dy,k+dz));
+				int index = Touch(i+dx,j+dy,k+dz);
+                gridPos[index] = max(particlePhi, gridPos[index]);
             }
 		}
     }
 }
 
-inline Double LevelSet::LinearSample(const Vector &pos) const
-{
-	static Double xlerp,ylerp,zlerp;
-    static int i0, i1, j0, j1, k0, k1;
-
-    i0 = int(pos[0]); i1 = i0 + 1;
-    j0 = int(pos[1]); j1 = j0 + 1;
-    k0 = int(pos[2]); k1 = k0 + 1;
-    xlerp = pos[0]-i0;
-	ylerp = pos[1]-j0;
-    zlerp = pos[2]-k0;
-
-    return Lerp(zlerp,
-                Lerp(ylerp,
-                     Lerp( xlerp, gridPhi(i0, j0, k0), gridPhi(i1, j0, k0) ),
-			         Lerp( xlerp, gridPhi(i0, j1, k0), gridPhi(i1, j1, k0) )),
-                Lerp(ylerp,
-                     Lerp( xlerp, gridPhi(i0, j0, k1), gridPhi(i1, j0, k1) ),
-                     Lerp( xlerp, gridPhi(i0, j1, k1), gridPhi(i1, j1, k1) )) );
-}
-
-Double LevelSet::CubicSample(const Vector &pos) const
+void LevelSet::Sample(Interpolation interp, const Double *x, const Double *y, const Double *z, int n, 
+					  Double *phi, Double *gx, Double *gy, Double *gz) const
 {
-    static Double r, s, t;
-    static int i0,i1,i2,i3,j0,j1,j2,j3,k0,k1,k2,k3;
-    
-    i0 = int(pos[0]) - 1; i1 = i0+1; i2 = i1+1; i3 = i2+1;
-    j0 = int(pos[1]) - 1; j1 = j0+1; j2 = j1+1; j3 = j2+1;
-    k0 = int(pos[2]) - 1; k1 = k0+1; k2 = k1+1; k3 = k2+1;
-    r = pos[0] - i1;
-    s = pos[1] - j1;
-    t = pos[2] - k1;
-    i0 = i0 < 0 ? 0 : i0; i3 = i3 > Nx+1 ? Nx+1 : i3;
-    j0 = j0 < 0 ? 0 : j0; j3 = j3 > Ny+1 ? Ny+1 : j3;
-    k0 = k0 < 0 ? 0 : k0; k3 = k3 > Nz+1 ? Nz+1 : k3;
-
-	return  MCerp(t, MCerp(r, MCerp(s, gridPhi(i0,j0,k0),gridPhi(i0,j1,k0),
-                              gridPhi(i0,j2,k0),gridPhi(i0,j3,k0)),
-                              MCerp(s, gridPhi(i1,j0,k0),gridPhi(i1,j1,k0),
-                              gridPhi(i1,j2,k0),gridPhi(i1,j3,k0)),
-                              MCerp(s, gridPhi(i2,j0,k0),gridPhi(i2,j1,k0),
-                              gridPhi(i2,j2,k0),gridPhi(i2,j3,k0)),
-                              MCerp(s, gridPhi(i3,j0,k0),gridPhi(i3,j1,k0),
-                              gridPhi(i3,j2,k0),gridPhi(i3,j3,k0)) ),
-                     MCerp(r, MCerp(s, gridPhi(i0,j0,k1),gridPhi(i0,j1,k1),
-                              gridPhi(i0,j2,k1),gridPhi(i0,j3,k1)),
-                              MCerp(s, gridPhi(i1,j0,k1),gridPhi(i1,j1,k1),
-                              gridPhi(i1,j2,k1),gridPhi(i1,j3,k1)),
-                              MCerp(s, gridPhi(i2,j0,k1),gridPhi(i2,j1,k1),
-                              gridPhi(i2,j2,k1),gridPhi(i2,j3,k1)),
-                              MCerp(s, gridPhi(i3,j0,k1),gridPhi(i3,j1,k1),
-                              gridPhi(i3,j2,k1),gridPhi(i3,j3,k1)) ),
-                     MCerp(r, MCerp(s, gridPhi(i0,j0,k2),gridPhi(i0,j1,k2),
-                              gridPhi(i0,j2,k2),gridPhi(i0,j3,k2)),
-                              MCerp(s, gridPhi(i1,j0,k2),gridPhi(i1,j1,k2),
-                              gridPhi(i1,j2,k2),gridPhi(i1,j3,k2)),
-                              MCerp(s, gridPhi(i2,j0,k2),gridPhi(i2,j1,k2),
-                              gridPhi(i2,j2,k2),gridPhi(i2,j3,k2)),
-                              MCerp(s, gridPhi(i3,j0,k2),gridPhi(i3,j1,k2),
-                              gridPhi(i3,j2,k2),gridPhi(i3,j3,k2)) ),
-                     MCerp(r, MCerp(s, gridPhi(i0,j0,k3),gridPhi(i0,j1,k3),
-                              gridPhi(i0,j2,k3),gridPhi(i0,j3,k3)),
-                              MCerp(s, gridPhi(i1,j0,k3),gridPhi(i1,j1,k3),
-                              gridPhi(i1,j2,k3),gridPhi(i1,j3,k3)),
-                              MCerp(s, gridPhi(i2,j0,k3),gridPhi(i2,j1,k3),
-                              gridPhi(i2,j2,k3),gridPhi(i2,j3,k3)),
-                              MCerp(s, gridPhi(i3,j0,k3),gridPhi(i3,j1,k3),
-                              gridPhi(i3,j2,k3),gridPhi(i3,j3,k3)) ) );
+	switch(interp) {
+	case INTERP_CUBIC:		 Sample<CubicInterpolation>(x, y, z, n, phi, gx, gy, gz); break;
+	case INTERP_CATMULL_ROM: Sample<CatmullRomInterpolation>(x, y, z, n, phi, gx, gy, gz); break;
+	default:				 Sample<LinearInterpolation>(x, y, z, n, phi, gx, gy, gz); break;
+	}
 }
 
+template<class Interp>
 void LevelSet::normal(const Vector &pos, Vector &n) const
 {
-	gradient(pos, n);
+	gradient<Interp>(pos, n);
 	n.Normalize();
 }
 
+template<class Interp>
 void LevelSet::gradient(const Vector &pos, Vector &g) const
 {
-	static Vector dx = (0.25 , 0.  , 0.  );
-	static Vector dy = (0.   , 0.25, 0.  );
-    static Vector dz = (0.   , 0.  , 0.25);
-	g[0] = SAMPLEPHI(pos+dx) - SAMPLEPHI(pos-dx);
-	g[1] = SAMPLEPHI(pos+dy) - SAMPLEPHI(pos-dy);
-    g[2] = SAMPLEPHI(pos+dz) - SAMPLEPHI(pos-dz);
-	g *= 2. * hInv;
+	Interp::Sample(gridPhi, pos[0], pos[1], pos[2], g[0], g[1], g[2]);
+	g *= hInv;
 }
 
+template<class Interp>
 void LevelSet::gradient(const Vector &pos, const Vector &u, Vector &g)
 {
-	static Vector dx = (0.25 , 0.  , 0.  );
-	static Vector dy = (0.   , 0.25, 0.  );
-    static Vector dz = (0.   , 0.  , 0.25);
-    static Double center;
-	center = SAMPLEPHI(pos);
-	if(u[0] < 0)	g[0] = (SAMPLEPHI(pos + dx) - center);
-	else			g[0] = (center - SAMPLEPHI(pos - dx));
-	if(u[1] < 0)	g[1] = (SAMPLEPHI(pos + dy) - center);
-	else			g[1] = (center - SAMPLEPHI(pos - dy));
-    if(u[2] < 0)	g[2] = (SAMPLEPHI(pos + dz) - center);
-	else			g[2] = (center - SAMPLEPHI(pos - dz));
-    g *= 4 * hInv;
-}
\ No newline at end of file
+	const Double d = 0.25;
+	Double x = pos[0], y = pos[1], z = pos[2];
+	Double center = Interp::Sample(gridPhi, x, y, z);
+	if(u[0] < 0)	g[0] = (Interp::Sample(gridPhi, x + d, y, z) - center);
+	else			g[0] = (center - Interp::Sample(gridPhi, x - d, y, z));
+	if(u[1] < 0)	g[1] = (Interp::Sample(gridPhi, x, y + d, z) - center);
+	else			g[1] = (center - Interp::Sample(gridPhi, x, y - d, z));
+	if(u[2] < 0)	g[2] = (Interp::Sample(gridPhi, x, y, z + d) - center);
+	else			g[2] = (center - Interp::Sample(gridPhi, x, y, z - d));
+	g *= 4 * hInv;
+}
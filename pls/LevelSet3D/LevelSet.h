@@ -30,28 +30,71 @@
 /*
 	LevelSet: A class for representing and working with a 3D LevelSets
 	Inputs: Grid size and cell size. For the sake of simplicity, cells are of uniform size
+			The buffer width of the grids (LEVELSET_GHOST by default) can also be given. With 2 
+			or more cells the cubic samplers run without clamping (see Interpolation)
 	
 	Four different Grids are stored by the class at one time. 
 	gridPhi  - contians the current levelset at any one time
 	gridTemp - used for updating gridPhi
 	gridPos  - used for error correction with escaped positive particles
 	gridNeg  - used for error correction with escaped negative particles
+	Fix only copies gridPhi into gridPos and gridNeg at the nodes escaped particles touch, and
+	only merges those back (a list of them is kept), so the correction costs nothing away 
+	from the escaped particles
 	
 	Finally a fastMarching grid is used for reinitializing the signed distance function
 
 	Public Functions:
 	Initialize		- This function has to be called before the simulation begins and is
-					  used to initialize the level set grid values
+					  used to initialize the level set grid values. The grid given may have
+					  another buffer width; buffer cells it does not have get BOUNDARY_PHI.
+					  A GridView of a volume in the caller's memory is copied straight into
+					  the level set, without a Grid in between
+	Attach			- Makes the level set work in the caller's memory given as a GridView, 
+					  without copying it. The memory has to have the layout of the level 
+					  set grid (GridView::Fits) and to outlive the level set or the next 
+					  Attach or checkpoint load. Its buffer cells are set to BOUNDARY_PHI. 
+					  The memory stays the level set (GetPhi) after every step: Update 
+					  copies it to the scratch grid and advects from there back into it
 	Update			- This function takes as input a velocity grid and timestep and updates
-					  the levelset using a fast first order accurate semi-lagrangian update
-	Fix				- Takes a particleSet as input and performs error correction on levelSet
+					  the levelset using a fast first order accurate semi-lagrangian update.
+					  The slabs of the grid are updated in parallel on the shared TaskPool.
+					  For a steady velocity field the backtrace of every cell (base index 
+					  and float weights) is computed once and cached, and each step only
+					  gathers and blends. The cache is rebuilt when the field (its Version) 
+					  or dt changes. The value at the end of the backtrace is interpolated 
+					  with the given Interpolation
+	Fix				- Takes a particleSet as input and performs error correction on levelSet.
+					  The level set is sampled at the particles with the given Interpolation.
+					  Returns FixStatistics: the escaped particles, the grid nodes they 
+					  corrected, and the cells of the reseed band with less than half of 
+					  ParticleSet::Target on the corrected level set. The level set is 
+					  sampled at the particles in parallel
+	FixAndResample	- Fix followed by ParticleSet::Resample in one pass over the particles. The
+					  phi sampled for the correction also sets the new radius, so the level 
+					  set is sampled once per particle (before the merge, where Resample 
+					  would sample the corrected one). The particles Particle::SetRadius 
+					  rejects are deleted by ParticleSet::Compact
 	ReInitialize	- Reinitializes the grid to a signed distance grid using the fast
-					  first order accurate fast marching method
+					  first order accurate fast marching method. The boundary cells are set 
+					  as Grid::SetBoundarySignedDist does while FastMarch copies the result back
 	LinearSample	- Takes as input a Float position within the grid and uses the four 
 					  surrounding cells for linearly interpolating the value of the 
 					  LevelSet at that point
 	CubicSample		- Same as LinearSample but uses Cubic interpolation. Although this is
 					  more accurate, it is considerable more expensive
+					  Both also come in a batched form that samples n points given as separate
+					  x, y and z arrays and, if gx, gy and gz are given, also returns the 
+					  gradient (the exact gradient of the trilinear interpolant for 
+					  LinearSample, central differences for CubicSample). This is the way to 
+					  do per particle queries; batches of SAMPLE_BATCH points work well. All
+					  sampling functions are thread safe
+	CatmullRomSample- Tensor product Catmull-Rom interpolation over the 4x4x4 surrounding
+					  cells. It is close to CubicSample in accuracy at a fraction of the cost.
+					  The batched form returns the exact gradient of the interpolant
+	Sample			- Batched sampling with an interpolation policy (see Interpolation.h) 
+					  given as template parameter, or with the Interpolation chosen at 
+					  runtime. The named samplers above are short forms of it
 	eval			- A function used by Marching Cubes for visualization
 			
 	Private Functions:
@@ -63,6 +106,11 @@
 	gradient		- Calculated the gradient at the given point. if a velocity is given
 					  it is used in the calculation of the gradient
 	SemiLagrangiaStep   - Performs the first order accurate semi lagrangian step
+	Advect, Fix		- The template forms of Update and Fix, one per interpolation policy.
+					  Update and Fix pick the one to run once per call
+	SampleAt		- Samples the level set at the particles into particlePhi
+	Merge			- Merges gridPos and gridNeg into gridPhi and counts the reseed band
+	Touch			- Readies a node for correction and lists it for Merge
 
 	Created by Emud Mokhberi: UCLA : 09/04/04
 */
@@ -71,29 +119,108 @@
 #define LEVELSET_H
 
 #include "Grid.h"
+#include "GridView.h"
 #include "FastMarch.h"
 #include "main.h"
 #include "impSurface.h"
 #include "vector.h"
+#include "Interpolation.h"
 	
+const int SAMPLE_BATCH = 256;
+
+// what a call of LevelSet::Fix found
+struct FixStatistics
+{
+	int particles;	// particles looked at
+	int escaped;	// particles on the wrong side of the interface
+	int corrected;	// grid nodes changed by escaped particles
+	int band;		// cells with a particle target (ParticleSet::Target)
+	int deficient;	// cells of the band with less than half their target of particles
+	int deleted;	// particles deleted by LevelSet::FixAndResample
+
+	FixStatistics() : particles(0), escaped(0), corrected(0), band(0), deficient(0), deleted(0) {}
+
+	// adds the counts of a later Fix of the same step. The cell counts are the later ones
+	void Accumulate(const FixStatistics &later)
+	{
+		escaped += later.escaped;
+		corrected += later.corrected;
+		deleted += later.deleted;
+		particles = later.particles;
+		band = later.band;
+		deficient = later.deficient;
+	}
+	static FixStatistics Join(const FixStatistics &a, const FixStatistics &b)
+	{
+		FixStatistics sum;
+		sum.particles = a.particles + b.particles;
+		sum.escaped = a.escaped + b.escaped;
+		sum.corrected = a.corrected + b.corrected;
+		sum.band = a.band + b.band;
+		sum.deficient = a.deficient + b.deficient;
+		sum.deleted = a.deleted + b.deleted;
+		return sum;
+	}
+};
+
 class LevelSet: public ImpSurface {
 public:
-	LevelSet(int nx,int ny, int nz, Double hi) 
-        : Nx(nx), Ny(ny), Nz(nz), h(hi), hInv(1./hi), size((nx+2)*(ny+2)*(nz+2)), 
-        gridPhi(nx,ny,nz), gridTmp(nx,ny,nz), gridPos(nx,ny,nz), gridNeg(nx,ny,nz) {}
+	LevelSet(int nx,int ny, int nz, Double hi, int ghost = LEVELSET_GHOST) 
+        : Nx(nx), Ny(ny), Nz(nz), h(hi), hInv(1./hi), 
+        gridPhi(nx,ny,nz,0.,ghost), gridTmp(nx,ny,nz,0.,ghost), gridPos(nx,ny,nz,0.,ghost), 
+        gridNeg(nx,ny,nz,0.,ghost), cachedGrid(NULL), cachedVersion(0), cachedDt(0), 
+        attached(NULL) 
+	{ 
+		gridPhi.GetSize(nx, ny, nz, size); 
+		touchedFlags.assign(size, 0);
+	}
 
     inline Double& operator[] (int index) { return gridPhi[index]; }
 	inline const Double& operator[] (int index) const { return gridPhi[index]; }
 	inline Double& operator() (int i, int j, int k) { return gridPhi(i,j,k); }
 	inline const Double& operator() (int i, int j, int k) const { return gridPhi(i,j,k); }
 
-	void Initialize(const Grid &init) { gridPhi = init; }
-	void Update(const Velocity &grid, const Double &dt);
-	void Fix(const ParticleSet &particleSet);
+	void Initialize(const Grid &init);
+	void Initialize(const GridView &init);
+	bool Attach(const GridView &phi);
+	inline Grid& GetPhi() { return gridPhi; }
+	inline const Grid& GetPhi() const { return gridPhi; }
+	void Update(const Velocity &grid, const Double &dt, Interpolation interp = INTERP_LINEAR);
+	FixStatistics Fix(const ParticleSet &particleSet, Interpolation interp = INTERP_LINEAR);
+	FixStatistics FixAndResample(ParticleSet &particleSet, Interpolation interp = INTERP_LINEAR);
 	void ReInitialize(FastMarch &gridFM);
 	
-	inline Double LinearSample(const Vector &pos) const;
-	Double CubicSample(const Vector &pos) const;
+	template<class Interp>
+	void Sample(const Double *x, const Double *y, const Double *z, int n, Double *phi,
+				Double *gx = NULL, Double *gy = NULL, Double *gz = NULL) const
+	{
+		if(gx == NULL) {
+			for(int p = 0; p < n; p++) phi[p] = Interp::Sample(gridPhi, x[p], y[p], z[p]);
+			return;
+		}
+		for(int p = 0; p < n; p++) {
+			phi[p] = Interp::Sample(gridPhi, x[p], y[p], z[p], gx[p], gy[p], gz[p]);
+			gx[p] *= hInv; gy[p] *= hInv; gz[p] *= hInv;
+		}
+	}
+	void Sample(Interpolation interp, const Double *x, const Double *y, const Double *z, int n, 
+				Double *phi, Double *gx = NULL, Double *gy = NULL, Double *gz = NULL) const;
+
+	inline Double LinearSample(const Vector &pos) const
+		{ return LinearInterpolation::Sample(gridPhi, pos[0], pos[1], pos[2]); }
+	inline Double CubicSample(const Vector &pos) const
+		{ return CubicInterpolation::Sample(gridPhi, pos[0], pos[1], pos[2]); }
+	inline Double CatmullRomSample(const Vector &pos) const
+		{ return CatmullRomInterpolation::Sample(gridPhi, pos[0], pos[1], pos[2]); }
+	inline void LinearSample(const Double *x, const Double *y, const Double *z, int n, Double *phi,
+							 Double *gx = NULL, Double *gy = NULL, Double *gz = NULL) const
+		{ Sample<LinearInterpolation>(x, y, z, n, phi, gx, gy, gz); }
+	inline void CubicSample(const Double *x, const Double *y, const Double *z, int n, Double *phi,
+							Double *gx = NULL, Double *gy = NULL, Double *gz = NULL) const
+		{ Sample<CubicInterpolation>(x, y, z, n, phi, gx, gy, gz); }
+	inline void CatmullRomSample(const Double *x, const Double *y, const Double *z, int n, Double *phi,
+								 Double *gx = NULL, Double *gy = NULL, Double *gz = NULL) const
+		{ Sample<CatmullRomInterpolation>(x, y, z, n, phi, gx, gy, gz); }
 
     virtual Double	eval	(const Point3d& location)
 	{
@@ -106,10 +233,26 @@ public:
 private:
 	inline void FixPos(const Particle &particle, int i, int j, int k);
 	inline void FixNeg(const Particle &particle, int i, int j, int k);
-	void normal(const Vector &pos, Vector &n) const;
-	void gradient(const Vector &pos, Vector &g) const;
-	void gradient(const Vector &pos, const Vector &u, Vector &g);
+	inline int Touch(int i, int j, int k);
+	template<class Interp> void Advect(const Velocity &grid, const Double &dt);
+	template<class Interp> FixStatistics Fix(const ParticleSet &particleSet);
+	template<class Interp> FixStatistics FixAndResample(ParticleSet &particleSet);
+	template<class Interp> void SampleAt(const CompactParticle *particles, int n);
+	FixStatistics Merge(const ParticleSet &particleSet);
+	template<class Interp> void normal(const Vector &pos, Vector &n) const;
+	template<class Interp> void gradient(const Vector &pos, Vector &g) const;
+	template<class Interp> void gradient(const Vector &pos, const Vector &u, Vector &g);
+	template<class Interp>
 	void SemiLagrangianStep(int x,int y, int z, const Velocity& grid, const Double &dt);
+	inline void TraceBack(int x, int y, int z, const Velocity &grid, const Double &dt,
+						  int &r, int &s, int &t, Double &a, Double &b, Double &c) const;
+	void CacheBacktraces(const Velocity &grid, const Double &dt);
+	template<class Interp> struct AdvectSlabs;
+	template<class Interp> struct AdvectCachedSlabs;
+	struct BacktraceSlabs;
+	struct MergeNodes;
+	struct BandSlabs;
+	template<class Interp> struct SampleParticles;
 
 	//grid size in each dimension
 	int Nx, Ny, Nz, size;
@@ -119,6 +262,23 @@ private:
 	Grid gridTmp;
 	Grid gridPos;
 	Grid gridNeg;
+	vector<int> cellParticles;	// particles per cell, scratch of Fix
+	vector<Double> particlePhi;	// gridPhi at the particles, scratch of Fix
+	vector<unsigned char> particleKeep;	// scratch of FixAndResample
+	vector<unsigned char> touchedFlags;	// 1 for the nodes in touched
+	vector<int> touched;		// nodes corrected by the running Fix
+
+	//semi-lagrangian backtraces for a steady velocity field, one per non-buffer cell
+	struct Backtrace
+	{
+		int base;		// index of the lower corner of the source cell in gridPhi
+		float a, b, c;	// weights of the upper corners in x, y and z
+	};
+	vector<Backtrace> backtraces;
+	const Velocity *cachedGrid;
+	unsigned int cachedVersion;
+	Double cachedDt;
+	const Double *attached;	// memory given to Attach, or NULL
 };
 
 
@@ -0,0 +1,61 @@
+#include "MACVelocity.h"
+
+// trilinear interpolation of g at (x,y,z) in the indices of g, clamped to the grid
+static inline Double SampleComponent(const Grid &g, Double x, Double y, Double z)
+{
+	int nx = g.GetNx(), ny = g.GetNy(), nz = g.GetNz();
+	x = Clamp(x, 0., Double(nx+1));
+	y = Clamp(y, 0., Double(ny+1));
+	z = Clamp(z, 0., Double(nz+1));
+	int i = min(int(x), nx), j = min(int(y), ny), k = min(int(z), nz);
+	Double xlerp = x - i, ylerp = y - j, zlerp = z - k;
+
+	int dj, dk;
+	g.GetStrides(dj, dk);
+	const Double *p = &g[g.Index(i,j,k)];
+	return Lerp(zlerp,
+				Lerp(ylerp, Lerp(xlerp, p[0],    p[1]),    Lerp(xlerp, p[dj],    p[dj+1])),
+				Lerp(ylerp, Lerp(xlerp, p[dk],   p[dk+1]), Lerp(xlerp, p[dj+dk], p[dj+dk+1])));
+}
+
+inline void MACVelocity::Sample(const Vector &pos, Vector &vel) const
+{
+	vel[0] = SampleComponent(u, pos[0] + 0.5, pos[1], pos[2]);
+	vel[1] = SampleComponent(v, pos[0], pos[1] + 0.5, pos[2]);
+	vel[2] = SampleComponent(w, pos[0], pos[1], pos[2] + 0.5);
+}
+
+void MACVelocity::GetVelocity(const Vector &pos, Vector &vel) const
+{
+	Sample(pos, vel);
+}
+
+void MACVelocity::GetVelocities(const Vector *pos, Vector *vel, int n) const
+{
+	for(int p = 0; p < n; p++) Sample(pos[p], vel[p]);
+}
+
+void MACVelocity::GetCellVelocity(int i, int j, int k, Vector &vel) const
+{
+	vel[0] = 0.5 * (u(i,j,k) + u(i+1,j,k));
+	vel[1] = 0.5 * (v(i,j,k) + v(i,j+1,k));
+	vel[2] = 0.5 * (w(i,j,k) + w(i,j,k+1));
+}
+
+void MACVelocity::Set(const Velocity &field)
+{
+	Vector vel;
+	for(int k = 0; k <= u.GetNz()+1; k++) for(int j = 0; j <= u.GetNy()+1; j++) for(int i = 0; i <= u.GetNx()+1; i++) {
+		field.GetVelocity(Vector(i - 0.5, j, k), vel);
+		u(i,j,k) = vel[0];
+	}
+	for(int k = 0; k <= v.GetNz()+1; k++) for(int j = 0; j <= v.GetNy()+1; j++) for(int i = 0; i <= v.GetNx()+1; i++) {
+		field.GetVelocity(Vector(i, j - 0.5, k), vel);
+		v(i,j,k) = vel[1];
+	}
+	for(int k = 0; k <= w.GetNz()+1; k++) for(int j = 0; j <= w.GetNy()+1; j++) for(int i = 0; i <= w.GetNx()+1; i++) {
+		field.GetVelocity(Vector(i, j, k - 0.5), vel);
+		w(i,j,k) = vel[2];
+	}
+	Modified();
+}
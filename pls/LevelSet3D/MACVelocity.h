@@ -0,0 +1,87 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	MACVelocity: A velocity grid on a staggered (MAC) grid
+
+	The components are stored on the faces of the cells, as a fluid solver produces them.
+	u(i,j,k) is the x velocity on the face between cells i-1 and i, at position (i-0.5,j,k),
+	v(i,j,k) is at (i,j-0.5,k) and w(i,j,k) at (i,j,k-0.5). Each component is a Grid with 
+	one more face than there are cells in its own direction, so U is (nx+1)*ny*nz, V is
+	nx*(ny+1)*nz and W is nx*ny*(nz+1), each with the usual buffer layer. The buffer faces 
+	are part of the field and have to be set as well. The grids can also be placed on 
+	buffers owned by someone else (a memory mapped frame, for instance); those have to 
+	outlive the field.
+
+	Functions:
+	U, V, W			- the component grids. Call Modified after changing them
+	GetVelocity		- trilinear interpolation of each component at an arbitrary point. 
+					  Points outside the grid are clamped to it
+	GetVelocities	- the same for an array of points, without a virtual call per point
+	GetCellVelocity	- the velocity at a cell centre: the average of the two faces of the
+					  cell in each direction, which is what GetVelocity returns there
+	Set				- samples another field on the faces, for instance to turn an 
+					  analytic field into a grid
+*/
+
+#ifndef MACVELOCITY_H
+#define MACVELOCITY_H
+
+#include "main.h"
+#include "Grid.h"
+#include "Velocity.h"
+
+class MACVelocity : public Velocity
+{
+public:
+	MACVelocity(int nx, int ny, int nz) 
+		: u(nx+1,ny,nz), v(nx,ny+1,nz), w(nx,ny,nz+1) {}
+	MACVelocity(int nx, int ny, int nz, Double *ubuf, Double *vbuf, Double *wbuf)
+		: u(nx+1,ny,nz,ubuf,NULL), v(nx,ny+1,nz,vbuf,NULL), w(nx,ny,nz+1,wbuf,NULL) {}
+
+	inline Grid& U() { return u; }
+	inline Grid& V() { return v; }
+	inline Grid& W() { return w; }
+	inline const Grid& U() const { return u; }
+	inline const Grid& V() const { return v; }
+	inline const Grid& W() const { return w; }
+
+	void GetVelocity(const Vector &pos, Vector &vel) const;
+	void GetVelocities(const Vector *pos, Vector *vel, int n) const;
+	void GetCellVelocity(int i, int j, int k, Vector &vel) const;
+
+	void Set(const Velocity &field);
+
+private:
+	inline void Sample(const Vector &pos, Vector &vel) const;
+
+	Grid u, v, w;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+MappedFile::MappedFile() : data(NULL), size(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {}
+
+bool MappedFile::Open(const char *filename, bool copyOnWrite)
+{
+	Close();
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+					   FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE) {
+		cerr << "couldn't open " << filename << endl;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx((HANDLE) file, &fileSize);
+	size = size_t(fileSize.QuadPart);
+	if(size > 0) {
+		mapping = CreateFileMappingA((HANDLE) file, NULL, 
+									 copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		if(mapping != NULL)
+			data = (char*) MapViewOfFile((HANDLE) mapping, 
+										 copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	}
+	if(data == NULL) {
+		cerr << "couldn't map " << filename << endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(data != NULL) UnmapViewOfFile(data);
+	if(mapping != NULL) CloseHandle((HANDLE) mapping);
+	if(file != INVALID_HANDLE_VALUE) CloseHandle((HANDLE) file);
+	data = NULL;
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+	size = 0;
+}
+
+// no portable way before Windows 8 (PrefetchVirtualMemory)
+bool MappedFile::Prefetch()
+{
+	return false;
+}
+
+#else
+//***********************************unix specific*********************************
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile() : data(NULL), size(0), fd(-1) {}
+
+bool MappedFile::Open(const char *filename, bool copyOnWrite)
+{
+	Close();
+	fd = open(filename, O_RDONLY);
+	if(fd < 0) {
+		cerr << "couldn't open " << filename << endl;
+		return false;
+	}
+	struct stat info;
+	if(fstat(fd, &info) == 0 && info.st_size > 0) {
+		size = size_t(info.st_size);
+		void *p = mmap(NULL, size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+					   MAP_PRIVATE, fd, 0);
+		if(p != MAP_FAILED) data = (char*) p;
+	}
+	if(data == NULL) {
+		cerr << "couldn't map " << filename << endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(data != NULL) munmap(data, size);
+	if(fd >= 0) close(fd);
+	data = NULL;
+	fd = -1;
+	size = 0;
+}
+
+bool MappedFile::Prefetch()
+{
+	return data != NULL && madvise(data, size, MADV_WILLNEED) == 0;
+}
+
+#endif
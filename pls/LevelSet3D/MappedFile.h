@@ -0,0 +1,82 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+/*
+	MappedFile: A read only or copy-on-write memory mapping of a whole file
+	
+	Mapping a file is used to load large binary data (checkpoints, velocity frames) 
+	without reading and parsing it: pages are brought in by the OS when they are first 
+	touched. With copyOnWrite set, the mapped memory can be modified; the changes are 
+	private to the process and never written back to the file.
+
+	Functions:
+	Open		- maps the file. Returns false (and prints a message) on failure
+	Close		- unmaps the file. Called by the destructor
+	Data		- start of the mapped memory
+	Size		- size of the file in bytes
+	Prefetch	- asks the OS to start reading the whole file in the background 
+				  (madvise). Returns false where this is not supported
+
+	A MappedFile can own the memory of a Grid (see Grid::Adopt).
+*/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "main.h"
+#include "Grid.h"
+
+class MappedFile : public GridStorage
+{
+public:
+	MappedFile();
+	~MappedFile() { Close(); }
+
+	bool Open(const char *filename, bool copyOnWrite = false);
+	void Close();
+	bool Prefetch();
+
+	inline char* Data() { return data; }
+	inline const char* Data() const { return data; }
+	inline size_t Size() const { return size; }
+	inline bool IsOpen() const { return data != NULL; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	char *data;
+	size_t size;
+#ifdef _WIN32
+	void *file, *mapping;	// HANDLEs
+#else
+	int fd;
+#endif
+};
+
+#endif
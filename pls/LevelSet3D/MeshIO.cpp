@@ -0,0 +1,391 @@
+#include "MeshIO.h"
+#include <cstring>
+#include <clocale>
+#include "TaskPool.h"
+
+static const int IO_BUFFER_SIZE   = 1 << 20;	// stdio buffer per open file
+static const int STAGING_ELEMENTS = 1 << 14;	// vertices/faces converted per fwrite
+
+static bool IsBigEndian()
+{
+	unsigned int one = 1;
+	return *((unsigned char*) &one) == 0;
+}
+
+/*
+ * Opens a file for binary output with a large fully buffered stdio buffer,
+ * so that the many small header writes and the bulk array writes all end up
+ * as a few large writes to disk. The buffer has to outlive the FILE.
+ */
+static FILE* OpenForWrite(const char* filename, char*& buffer)
+{
+	buffer = NULL;
+	FILE* fp = fopen(filename, "wb");
+	if (fp == NULL)
+	{
+		cerr << "couldn't open " << filename << " for writing" << endl;
+		return NULL;
+	}
+	buffer = new char[IO_BUFFER_SIZE];
+	setvbuf(fp, buffer, _IOFBF, IO_BUFFER_SIZE);
+	return fp;
+}
+
+static bool CloseWrite(FILE* fp, char* buffer, const char* filename)
+{
+	bool ok = !ferror(fp);
+	if (fclose(fp) != 0)
+		ok = false;
+	delete[] buffer;
+	if (!ok)
+		cerr << "error writing " << filename << endl;
+	return ok;
+}
+
+/*
+ * Converts count tuples starting at first to floats, stride floats apart.
+ */
+template <class T>
+static void StageTuples(const vector<T>& src, int first, int count, 
+						float* dst, int stride)
+{
+	for (int i = first; i < first + count; ++i, dst += stride)
+	{
+		const Double* p = src[i].ptr();
+		dst[0] = (float) p[0];
+		dst[1] = (float) p[1];
+		dst[2] = (float) p[2];
+	}
+}
+
+bool WritePLY (const char* filename, const IsoSurface& surface)
+{
+	const vector<Point3d>&		vertices = surface.getVertices();
+	const vector<Vector3d>&		normals  = surface.getNormals();
+	const vector<MeshTriangle>&	faces    = surface.getFaces();
+	int numVertices = (int) vertices.size();
+	int numFaces	= (int) faces.size();
+	bool hasNormals = (int) normals.size() == numVertices;
+
+	char* buffer;
+	FILE* fp = OpenForWrite(filename, buffer);
+	if (fp == NULL)
+		return false;
+
+	fprintf(fp, "ply\nformat %s 1.0\n", 
+			IsBigEndian() ? "binary_big_endian" : "binary_little_endian");
+	fprintf(fp, "element vertex %d\n", numVertices);
+	fprintf(fp, "property float x\nproperty float y\nproperty float z\n");
+	if (hasNormals)
+		fprintf(fp, "property float nx\nproperty float ny\nproperty float nz\n");
+	fprintf(fp, "element face %d\n", numFaces);
+	fprintf(fp, "property list uchar uint vertex_indices\nend_header\n");
+
+	int stride = hasNormals ? 6 : 3;
+	vector<float> staging(STAGING_ELEMENTS * stride);
+	for (int first = 0; first < numVertices; first += STAGING_ELEMENTS)
+	{
+		int count = min(STAGING_ELEMENTS, numVertices - first);
+		StageTuples(vertices, first, count, &staging[0], stride);
+		if (hasNormals)
+			StageTuples(normals, first, count, &staging[3], stride);
+		fwrite(&staging[0], sizeof(float), count * stride, fp);
+	}
+
+	// each face is a one byte vertex count followed by the three indices
+	const int faceBytes = 1 + 3 * sizeof(unsigned int);
+	vector<unsigned char> faceStaging(STAGING_ELEMENTS * faceBytes);
+	for (int first = 0; first < numFaces; first += STAGING_ELEMENTS)
+	{
+		int count = min(STAGING_ELEMENTS, numFaces - first);
+		unsigned char* dst = &faceStaging[0];
+		for (int i = first; i < first + count; ++i, dst += faceBytes)
+		{
+			unsigned int indices[3] = { faces[i][0], faces[i][1], faces[i][2] };
+			dst[0] = 3;
+			memcpy(dst + 1, indices, sizeof(indices));
+		}
+		fwrite(&faceStaging[0], 1, count * faceBytes, fp);
+	}
+
+	return CloseWrite(fp, buffer, filename);
+}
+
+bool WriteMesh (const char* filename, const IsoSurface& surface)
+{
+	MeshWriter writer;
+	if (!writer.open(filename))
+		return false;
+	writer.write(surface, 0, 0);
+	return writer.close();
+}
+
+/*******************************************************************
+ * Class MeshWriter
+ * writes the native mesh format one chunk at a time
+ ******************************************************************/
+MeshWriter::MeshWriter ()
+:fp(NULL),
+ ioBuffer(NULL),
+ numVertices(0),
+ numFaces(0),
+ failed(false)
+{
+}
+
+MeshWriter::~MeshWriter ()
+{
+	if (fp != NULL)
+		close();
+}
+
+bool MeshWriter::open (const char* filename)
+{
+	if (fp != NULL)
+		close();
+
+	fp = OpenForWrite(filename, ioBuffer);
+	if (fp == NULL)
+		return false;
+	numVertices = 0;
+	numFaces = 0;
+	failed = false;
+
+	unsigned int header[2] = { MESH_VERSION, MESH_HAS_NORMALS };
+	fwrite("LSMH", 1, 4, fp);
+	fwrite(header, sizeof(unsigned int), 2, fp);
+	return true;
+}
+
+/*
+ * Writes the vertices from firstVertex and the faces from firstFace onward
+ * as one chunk. Vertices without a normal get a zero normal.
+ */
+void MeshWriter::write (const IsoSurface& surface, int firstVertex, int firstFace)
+{
+	if (fp == NULL)
+		return;
+
+	const vector<Point3d>&		vertices = surface.getVertices();
+	const vector<Vector3d>&		normals  = surface.getNormals();
+	const vector<MeshTriangle>&	faces    = surface.getFaces();
+	unsigned int counts[2] = { (unsigned int) vertices.size() - firstVertex, 
+							   (unsigned int) faces.size() - firstFace };
+	if (counts[0] == 0 && counts[1] == 0)
+		return;
+
+	fwrite(counts, sizeof(unsigned int), 2, fp);
+
+	staging.resize(3 * STAGING_ELEMENTS);
+	for (int first = firstVertex; first < (int) vertices.size(); first += STAGING_ELEMENTS)
+	{
+		int count = min(STAGING_ELEMENTS, (int) vertices.size() - first);
+		StageTuples(vertices, first, count, &staging[0], 3);
+		fwrite(&staging[0], sizeof(float), 3 * count, fp);
+	}
+	for (int first = firstVertex; first < (int) vertices.size(); first += STAGING_ELEMENTS)
+	{
+		int count = min(STAGING_ELEMENTS, (int) vertices.size() - first);
+		int known = max(0, min(count, (int) normals.size() - first));
+		fill(staging.begin(), staging.begin() + 3 * count, 0.f);
+		StageTuples(normals, first, known, &staging[0], 3);
+		fwrite(&staging[0], sizeof(float), 3 * count, fp);
+	}
+
+	// MeshTriangle is three packed indices (glDraw relies on this as well)
+	if (counts[1] > 0)
+		fwrite(&faces[firstFace], sizeof(unsigned int), 3 * counts[1], fp);
+
+	numVertices += counts[0];
+	numFaces += counts[1];
+	if (ferror(fp))
+		failed = true;
+}
+
+bool MeshWriter::close ()
+{
+	if (fp == NULL)
+		return false;
+
+	unsigned int trailer[4] = { 0, 0, numVertices, numFaces };
+	fwrite(trailer, sizeof(unsigned int), 4, fp);
+
+	bool ok = CloseWrite(fp, ioBuffer, "mesh file") && !failed;
+	fp = NULL;
+	ioBuffer = NULL;
+	return ok;
+}
+
+/*******************************************************************
+ * POV-Ray mesh2 output
+ * Each of the vertex, normal and face blocks is cut into chunks which
+ * are formatted into separate strings in parallel and then joined.
+ ******************************************************************/
+static const int POV_MIN_CHUNK = 4096;	// elements; smaller blocks aren't split
+
+enum { POV_VERTICES, POV_NORMALS, POV_FACES };
+
+struct POVChunk
+{
+	const IsoSurface*	surface;
+	int					block;
+	int					begin, end;
+	char				point;		// decimal point of the C locale
+	string				text;
+};
+
+struct POVFormatter
+{
+	vector<POVChunk>*	chunks;
+	void operator() (int begin, int end) const;
+};
+
+// doubles as an ostream with default flags prints them: %g, 6 digits
+static inline void AppendDouble(string& out, Double value, char point)
+{
+	char buf[32];
+	int n = sprintf(buf, "%g", value);
+	if (point != '.')
+		for (int i = 0; i < n; ++i)
+			if (buf[i] == point)
+				buf[i] = '.';
+	out.append(buf, n);
+}
+
+static inline void AppendUInt(string& out, unsigned int value)
+{
+	char buf[16];
+	int n = 16;
+	do 
+	{ 
+		buf[--n] = char('0' + value % 10); 
+		value /= 10; 
+	} while (value);
+	out.append(buf + n, 16 - n);
+}
+
+static void FormatPOVChunk(POVChunk& chunk)
+{
+	const vector<Point3d>&		vertices = chunk.surface->getVertices();
+	const vector<Vector3d>&		normals  = chunk.surface->getNormals();
+	const vector<MeshTriangle>&	faces    = chunk.surface->getFaces();
+	string& out = chunk.text;
+
+	out.reserve((chunk.end - chunk.begin) * 48);
+	if (chunk.block == POV_FACES)
+	{
+		int last = (int) faces.size() - 1;
+		for (int i = chunk.begin; i < chunk.end; ++i)
+		{
+			out.append("\t\t<");
+			AppendUInt(out, faces[i][0]);
+			out.append(", ");
+			AppendUInt(out, faces[i][1]);
+			out.append(", ");
+			AppendUInt(out, faces[i][2]);
+			out.append(i < last ? ">,\n" : ">\n");
+		}
+	}
+	else
+	{
+		int last = (int) vertices.size() - 1;
+		for (int i = chunk.begin; i < chunk.end; ++i)
+		{
+			const Tuple3d& t = chunk.block == POV_VERTICES ? 
+							   (const Tuple3d&) vertices[i] : (const Tuple3d&) normals[i];
+			out.append("\t\t<");
+			AppendDouble(out, t[0], chunk.point);
+			out.append(", ");
+			AppendDouble(out, t[1], chunk.point);
+			out.append(", ");
+			AppendDouble(out, t[2], chunk.point);
+			out.append(i < last ? ">, \n" : ">\n");
+		}
+	}
+}
+
+void POVFormatter::operator() (int begin, int end) const
+{
+	for (int i = begin; i < end; ++i)
+		FormatPOVChunk((*chunks)[i]);
+}
+
+static void AddPOVChunks(vector<POVChunk>& chunks, const IsoSurface& surface, 
+						 int block, int count, int numThreads, char point)
+{
+	int pieces = max(1, min(numThreads, count / POV_MIN_CHUNK));
+	for (int p = 0; p < pieces; ++p)
+	{
+		POVChunk chunk;
+		chunk.surface = &surface;
+		chunk.block = block;
+		chunk.begin = (int) ((long long) count * p / pieces);
+		chunk.end = (int) ((long long) count * (p + 1) / pieces);
+		chunk.point = point;
+		chunks.push_back(chunk);
+	}
+}
+
+void FormatPOVRay (const IsoSurface& surface, string& text, int numThreads)
+{
+	TaskPool& pool = TaskPool::Shared();
+	if (numThreads <= 0)
+		numThreads = pool.NumThreads();
+	int numVertices = (int) surface.getVertices().size();
+	int numFaces = (int) surface.getFaces().size();
+	char point = localeconv()->decimal_point[0];
+
+	vector<POVChunk> chunks;
+	AddPOVChunks(chunks, surface, POV_VERTICES, numVertices, numThreads, point);
+	int normalsAt = (int) chunks.size();
+	AddPOVChunks(chunks, surface, POV_NORMALS, numVertices, numThreads, point);
+	int facesAt = (int) chunks.size();
+	AddPOVChunks(chunks, surface, POV_FACES, numFaces, numThreads, point);
+
+	POVFormatter formatter;
+	formatter.chunks = &chunks;
+	if (numThreads == 1)
+		formatter(0, (int) chunks.size());
+	else
+		ParallelFor(pool, 0, (int) chunks.size(), 1, formatter);
+
+	size_t total = 512;
+	for (int i = 0; i < (int) chunks.size(); ++i)
+		total += chunks[i].text.size();
+
+	text.clear();
+	text.reserve(total);
+	text.append("#include \"template.pov\"\nmesh2{\n");
+	for (int i = 0; i < (int) chunks.size(); ++i)
+	{
+		if (i == 0)
+		{
+			text.append("\tvertex_vectors{\n\t\t");
+			AppendUInt(text, numVertices);
+			text.append(",\n");
+		}
+		else if (i == normalsAt)
+		{
+			text.append("\n\t}\n\tnormal_vectors{\n\t\t");
+			AppendUInt(text, numVertices);
+			text.append(",\n");
+		}
+		else if (i == facesAt)
+		{
+			text.append("\n\t}\n\tface_indices{\n\t\t");
+			AppendUInt(text, numFaces);
+			text.append(",\n");
+		}
+		text.append(chunks[i].text);
+		string().swap(chunks[i].text);
+	}
+	text.append("\t}\n\tpigment {rgb 1}\n");
+	text.append("\tphotons {\n\trefraction off\n\treflection off\n\tcollect on\n\t}\n}\n");
+}
+
+bool WritePOVRay (FILE* fp, const IsoSurface& surface, int numThreads)
+{
+	string text;
+	FormatPOVRay(surface, text, numThreads);
+	return fwrite(text.data(), 1, text.size(), fp) == text.size();
+}
@@ -0,0 +1,99 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	MeshIO: Binary output of the isosurface mesh
+
+	The POV-Ray output (operator << on IsoSurface) is text and is written line by line. 
+	The functions here write the vertex, normal and face arrays in bulk through a large 
+	stdio buffer instead.
+
+	WritePLY		- writes a finished IsoSurface as a binary PLY file. Vertices are stored
+					  as float x,y,z,nx,ny,nz and faces as a uchar count followed by three
+					  uint indices. The byte order in the header is the one of the host.
+	WriteMesh		- writes a finished IsoSurface in the native mesh format (see below)
+	MeshWriter		- writes the native mesh format incrementally. It is an IsoSurfaceSink, 
+					  so it can be given to MarchCube::setSink and will then write each layer
+					  as soon as the mesher has finished it.
+
+	Native mesh format (host byte order):
+		header	- char[4] "LSMH", uint version, uint flags (MESH_HAS_NORMALS)
+		chunk	- uint vertex count n, uint face count m, float[3n] positions,
+				  float[3n] normals (if flagged), uint[3m] face indices
+		trailer - a chunk with n = m = 0 followed by uint total vertices, uint total faces
+	Face indices are global over the whole file, so a face may refer to vertices written
+	in an earlier chunk.
+
+	FormatPOVRay	- produces the same text as operator << on IsoSurface, with the vertex,
+					  normal and face blocks split into numThreads chunks each (0 = as many
+					  as the shared TaskPool has threads, 1 = formatted on the calling thread)
+					  that are formatted on the shared TaskPool. Numbers are formatted
+					  without going through iostreams, with '.' as the decimal point
+					  regardless of the current locale.
+	WritePOVRay		- formats the mesh with FormatPOVRay and writes it with a single fwrite
+*/
+
+#ifndef MESHIO_H
+#define MESHIO_H
+
+#include "main.h"
+#include "impsurface.h"
+
+const unsigned int MESH_VERSION		= 1;
+const unsigned int MESH_HAS_NORMALS	= 1 << 0;
+
+bool WritePLY	(const char* filename, const IsoSurface& surface);
+bool WriteMesh	(const char* filename, const IsoSurface& surface);
+
+void FormatPOVRay	(const IsoSurface& surface, string& text, int numThreads = 0);
+bool WritePOVRay	(FILE* fp, const IsoSurface& surface, int numThreads = 0);
+
+class MeshWriter : public IsoSurfaceSink
+{
+public:
+	MeshWriter	();
+	~MeshWriter	();
+
+	bool	open		(const char* filename);
+	bool	close		();
+	bool	isOpen		() const { return fp != NULL; }
+
+	void	write		(const IsoSurface& surface, int firstVertex, int firstFace);
+	void	layerDone	(const IsoSurface& surface, int firstVertex, int firstFace)
+							{ write(surface, firstVertex, firstFace); }
+private:
+	FILE*				fp;
+	char*				ioBuffer;
+	vector<float>		staging;
+	unsigned int		numVertices;
+	unsigned int		numFaces;
+	bool				failed;
+};
+
+#endif // MESHIO_H
@@ -44,12 +44,24 @@
 				  positive for exterior particles
 	Radius		- returns the radius of the particle
 	GetPosition - returns the position of the particle
+	SetPosition - moves the particle, for code that advects particles itself
 	SetRadius   - takes as input an updated signed distance value of the particles position within
 				  the grid and resets the radius of the particle based on this new value
 	Update		- takes as input a velocity grid and a timestep and updates the particle
 				  using standard lagrangian method with a second order accurate runga kutta
 			      time integration
 
+	CompactParticle: the form in which ParticleSet stores its particles, 12 bytes instead of
+	the 40 of a Particle. The position is kept as the cell (i, j and k in 10 bits each, so
+	grids of up to PARTICLE_MAX_CELLS = 1022 cells a side; ParticleSet refuses larger ones)
+	and the offset within the cell in 16 bits per axis, good to 1/131072 of a cell. The 
+	radius is kept between RADIUS_MIN and RADIUS_MAX in 15 bits, and the sign in the 
+	remaining bit. It has the same functions as Particle, plus
+	GetCell		- the cell of the particle, without decoding the position
+	Morton		- the Morton code of the cell (the bits of i, j and k interleaved), for 
+				  sorting particles so that neighbours in the array are neighbours in the grid
+	Decode		- the Particle it stands for
+
 	Created by Emud Mokhberi: UCLA : 09/04/04
 */
 
@@ -60,6 +72,9 @@
 #include "Vector.h"
 #include "Velocity.h"
 
+const Double PARTICLE_OFFSET_SCALE = 1. / 65536;	// of the cell offsets of a CompactParticle
+const int PARTICLE_MAX_CELLS = 1022;				// grid cells a side a CompactParticle can address
+
 //Radius and position are based on index of grid. They are adjusted to reflect 
 //cell size h when calculating phi.
 class Particle
@@ -73,12 +88,14 @@ public:
 		else if(radius < RADIUS_MIN) radius = RADIUS_MIN;
 		position = pos;
 	}
+	Particle(const Vector &pos, int s, const Double &r) : position(pos), sign(s), radius(r) {}
 
 	inline Double phi(const Vector &point, const Double &h) const 
 		{ return sign * (radius - (point - position).Length()) * h; }
 	inline int Sign() const { return sign; }
 	Double Radius() const { return radius; }
 	inline void GetPosition(Vector &pos) const { pos = position; }
+	inline void SetPosition(const Vector &pos) { position = pos; }
 	inline bool SetRadius(const Double &phi, const Double &hInv)
 	{
 		if((phi * sign < 0.) && (abs(phi) > PARTICLE_DELETE)) return false;
@@ -90,7 +107,7 @@ public:
     void Update(const Velocity &grid, const Double &dt, const Double &hInv)
     {
         //RK2 update
-        static Vector u, p2;
+        Vector u, p2;
         grid.GetVelocity(position, u);
         p2 = position + u * dt * hInv;
         grid.GetVelocity(p2, u);
@@ -104,4 +121,86 @@ private:
 	Double radius;
 };
 
+class CompactParticle
+{
+public:
+	CompactParticle() {}
+	CompactParticle(const Particle &particle)
+	{
+		Vector pos;
+		particle.GetPosition(pos);
+		SetPosition(pos);
+		radius = particle.Sign() < 0 ? SIGN_BIT : 0;
+		SetRadius(particle.Radius());
+	}
+
+	inline Double phi(const Vector &point, const Double &h) const 
+		{ return Decode().phi(point, h); }
+	inline int Sign() const { return (radius & SIGN_BIT) ? -1 : 1; }
+	inline Double Radius() const 
+		{ return RADIUS_MIN + (radius & RADIUS_BITS) * ((RADIUS_MAX - RADIUS_MIN) / RADIUS_BITS); }
+	inline void GetCell(int &i, int &j, int &k) const 
+		{ i = cell & CELL_BITS; j = (cell >> 10) & CELL_BITS; k = cell >> 20; }
+	inline unsigned int Morton() const
+		{ return Spread(cell & CELL_BITS) | Spread((cell >> 10) & CELL_BITS) << 1 | Spread(cell >> 20) << 2; }
+	inline void GetPosition(Vector &pos) const
+	{
+		int i, j, k;
+		GetCell(i, j, k);
+		pos = Vector(i + (x + 0.5) * PARTICLE_OFFSET_SCALE, j + (y + 0.5) * PARTICLE_OFFSET_SCALE, 
+					 k + (z + 0.5) * PARTICLE_OFFSET_SCALE);
+	}
+	inline void SetPosition(const Vector &pos)
+	{
+		int i = Quantize(pos[0], x), j = Quantize(pos[1], y), k = Quantize(pos[2], z);
+		cell = (unsigned int)(i | (j << 10) | (k << 20));
+	}
+	inline bool SetRadius(const Double &phi, const Double &hInv)
+	{
+		if((phi * Sign() < 0.) && (abs(phi) > PARTICLE_DELETE)) return false;
+		SetRadius(abs(phi) * hInv);
+		return true;
+	}
+	inline Particle Decode() const 
+	{
+		Vector pos;
+		GetPosition(pos);
+		return Particle(pos, Sign(), Radius());
+	}
+
+private:
+	enum { CELL_BITS = 1023, RADIUS_BITS = 0x7fff, SIGN_BIT = 0x8000 };
+
+	// moves the 10 bits of v to every third bit
+	static inline unsigned int Spread(unsigned int v)
+	{
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+	// stores the offset of c within its cell in q and returns the cell
+	static inline int Quantize(const Double &c, unsigned short &q)
+	{
+		int cell = c > 0 ? int(c) : 0;
+		if(cell > CELL_BITS) cell = CELL_BITS;
+		Double offset = (c - cell) * 65536;
+		q = offset <= 0 ? 0 : (offset >= 65535 ? 65535 : (unsigned short)offset);
+		return cell;
+	}
+	// r in grid cells, clamped to [RADIUS_MIN, RADIUS_MAX]
+	inline void SetRadius(Double r)
+	{
+		if(r > RADIUS_MAX) r = RADIUS_MAX;
+		else if(r < RADIUS_MIN) r = RADIUS_MIN;
+		radius = (unsigned short)((radius & SIGN_BIT) | 
+				 int((r - RADIUS_MIN) * (RADIUS_BITS / (RADIUS_MAX - RADIUS_MIN)) + 0.5));
+	}
+
+	unsigned int cell;			// i | j << 10 | k << 20
+	unsigned short x, y, z;		// offset within the cell in 1/65536 of a cell
+	unsigned short radius;		// SIGN_BIT for interior particles | quantized radius
+};
+
 #endif
@@ -25,112 +25,577 @@
 
  Commercial use is strictly prohibited.
 ***************************************************************************/
+
+
+/*
+	ParticleSet: A class for representing the set of particles used in error correcting the Level Set
+	Inputs: Size of grid and cell
+			
+	This class only stores an array with all the particles within the grid, as CompactParticles 
+	(see Particle.h). Note that the particles are not stored per cell, but for the entire grid. 
+	Grids can have up to PARTICLE_MAX_CELLS (1022) cells a side; the constructor stops the
+	program for larger ones, since their particles would pile up on the far faces. The 
+	array is contiguous, so the passes over the particles split it into chunks and run them
+	in parallel. Particles are deleted by stream compaction (Compact), which keeps the order
+	of the survivors
+
+	Functions:
+	Update		- takes as input a velocity grid and a timestep. Calls the update function for
+				  each partricle and removes it if the particle has exited the grid. The 
+				  particles are advected in parallel on the shared TaskPool
+	Resample	- Updates the radius for each particle. Only use this function is necessary
+	Reseed		- Deletes all particles and creates new ones. Only use this function when
+			      absolutely necessary
+				  Both sample the level set with the given Interpolation (linear by default).
+				  Their template forms take the interpolation policy instead. Reseed 
+				  places the particles of a cell with a Philox generator keyed on the seed 
+				  (SetSeed) and the number of reseeds so far, and counted by the cell index 
+				  and the particle slot. The particles therefore do not depend on the order
+				  in which the cells are visited
+	TopUp		- Incremental Reseed. Deletes the particles of cells that have left the band
+				  and the excess of over-full cells, and adds only the missing particles 
+				  of the others. The cell targets, the deletions (Trim) and the new 
+				  particles are computed in parallel over slabs, so it is cheap enough to
+				  run every step
+	Target		- the number of particles Reseed puts into a cell
+	Data		- the particle array, for passes that run over it in parallel (LevelSet::Fix)
+	Add			- stores a Particle, encoded as a CompactParticle
+	Sort		- sorts the particles by the Morton code of their cell, with a parallel radix
+				  sort (8 bit digits, histograms per chunk). Particles drift away from the 
+				  order they were seeded in, and a sorted array keeps the level set and 
+				  velocity lookups of Update and LevelSet::Fix local. The sort is stable
+	Disorder	- the fraction of the particles whose cell comes before the cell of the 
+				  previous particle in Morton order. It is below 0.02 right after Reseed 
+				  and 0 after Sort, so it tells when another Sort pays off
+	Trim		- keeps the first particles of every cell up to its target and deletes the 
+				  rest, for TopUp. The cells decide in parallel, slab by slab, and the 
+				  result is the same as a serial pass over the array
+	Compact		- deletes the particles whose keep flag is 0 and closes the gaps. Every chunk
+				  counts its survivors, and a prefix sum of the counts gives where each chunk
+				  scatters them, so both passes run in parallel
+				  
+	Created by Emud Mokhberi: UCLA : 09/04/04
+*/
+
+#ifndef PARTICLESET_H
+#define PARTICLESET_H
+
+#include "main.h"
+#include "Vector.h"
+
+#include "LevelSet.h"
+#include "Particle.h"
+#include "Velocity.h"
+#include "TaskPool.h"
+#include "Philox.h"
+
+const int PARTICLE_CHUNK = 4096;	// particles per task of the parallel passes
+
+// advects the particles begin ... end-1 of an array, the same way as Particle::Update but 
+// looking up the velocities of a batch of particles at once. Particles that leave the box
+// [0, upper] get a keep flag of 0
+struct ParticleAdvect
+{
+	enum { BATCH = 256 };
+	CompactParticle *particles;
+	unsigned char *keep;
+	const Velocity *grid;
+	Double dt, hInv;
+	Vector upper;
+	void operator()(int begin, int end) const
+	{
+		Vector p1[BATCH], p2[BATCH], u[BATCH];
+		for(int first = begin; first < end; first += BATCH) {
+			int n = min(int(BATCH), end - first);
+			for(int p = 0; p < n; p++) particles[first+p].GetPosition(p1[p]);
+			//RK2 update
+			grid->GetVelocities(p1, u, n);
+			for(int p = 0; p < n; p++) p2[p] = p1[p] + u[p] * dt * hInv;
+			grid->GetVelocities(p2, u, n);
+			for(int p = 0; p < n; p++) {
+				p2[p] += u[p] * dt * hInv;
+				p1[p] = (p1[p] + p2[p]) * 0.5;
+				particles[first+p].SetPosition(p1[p]);
+				keep[first+p] = p1[p][0] >= 0 && p1[p][0] <= upper[0] &&
+								p1[p][1] >= 0 && p1[p][1] <= upper[1] &&
+								p1[p][2] >= 0 && p1[p][2] <= upper[2];
+			}
+		}
+	}
+};
+
+class ParticleSet
+{
+private:
+	int Nx, Ny, Nz;
+	vector<CompactParticle> particles;
+    Double h, hInv;
+	unsigned int seed, reseeds;	// key of the Philox generator of the next Reseed
+public:
+	ParticleSet(int nx,int ny, int nz, Double hi) 
+		: Nx(nx), Ny(ny), Nz(nz), h(hi), hInv(1./hi), seed(4357), reseeds(0) 
+	{
+		if(max(nx, max(ny, nz)) > PARTICLE_MAX_CELLS) {
+			cerr << "ParticleSet: grids of more than " << PARTICLE_MAX_CELLS 
+				 << " cells a side can't be stored in CompactParticles" << endl;
+			abort();
+		}
+	}
+	~ParticleSet() { Clear(); }
+
+	typedef vector<CompactParticle>::iterator Iterator;
+	typedef vector<CompactParticle>::const_iterator cIterator;
+	cIterator begin() const { return particles.begin(); }
+	cIterator end()   const { return particles.end(); }
+	int Count() const { return int(particles.size()); }
+	inline CompactParticle* Data() { return particles.empty() ? NULL : &particles[0]; }
+	inline const CompactParticle* Data() const { return particles.empty() ? NULL : &particles[0]; }
+	inline void SetSeed(unsigned int s, unsigned int frame = 0) { seed = s; reseeds = frame; }
+	inline unsigned int GetSeed() const { return seed; }
+	inline unsigned int GetReseeds() const { return reseeds; }
+
+	void Add(const Particle &p) { particles.push_back(p); }
+	void Clear() { particles.clear(); }
+
+	// creates n particles at the given positions
+	template<class Interp>
+	void AddSampled(const LevelSet& levelSet, const Double *x, const Double *y, const Double *z, 
+					Double *phi, int n)
+	{
+		levelSet.Sample<Interp>(x, y, z, n, phi);
+		for(int p = 0; p < n; p++)
+			particles.push_back(Particle(Vector(x[p], y[p], z[p]), phi[p], hInv));
+	}
+
+	void Update(const Velocity& grid, const Double &dt)
+	{
+        if(particles.empty()) return;
+        keep.resize(particles.size());
+        ParticleAdvect advect;
+        advect.particles = &particles[0];
+        advect.keep = &keep[0];
+        advect.grid = &grid;
+        advect.dt = dt;
+        advect.hInv = hInv;
+        advect.upper = Vector(Nx+1, Ny+1, Nz+1);
+        ParallelFor(TaskPool::Shared(), 0, Count(), PARTICLE_CHUNK, advect);
+        Compact(&keep[0]);
+	}
+	void Resample(const LevelSet& levelSet, Interpolation interp = INTERP_LINEAR) // updates particle radii;
+	{
+		switch(interp) {
+		case INTERP_CUBIC:		 Resample<CubicInterpolation>(levelSet); break;
+		case INTERP_CATMULL_ROM: Resample<CatmullRomInterpolation>(levelSet); break;
+		default:				 Resample<LinearInterpolation>(levelSet); break;
+		}
+	}
+	template<class Interp>
+	void Resample(const LevelSet& levelSet)
+	{
+		if(particles.empty()) return;
+		keep.resize(particles.size());
+		ParticleResample<Interp> resample;
+		resample.levelSet = &levelSet;
+		resample.particles = &particles[0];
+		resample.keep = &keep[0];
+		resample.hInv = hInv;
+		ParallelFor(TaskPool::Shared(), 0, Count(), PARTICLE_CHUNK, resample);
+		Compact(&keep[0]);
+	}
+	void Reseed(const LevelSet& levelSet, Interpolation interp = INTERP_LINEAR) // deletes particles and creates new ones
+	{
+		switch(interp) {
+		case INTERP_CUBIC:		 Reseed<CubicInterpolation>(levelSet); break;
+		case INTERP_CATMULL_ROM: Reseed<CatmullRomInterpolation>(levelSet); break;
+		default:				 Reseed<LinearInterpolation>(levelSet); break;
+		}
+	}
+	template<class Interp>
+	void Reseed(const LevelSet& levelSet)
+	{
+		Double x[SAMPLE_BATCH], y[SAMPLE_BATCH], z[SAMPLE_BATCH], phis[SAMPLE_BATCH];
+		int n = 0;
+		Philox philox(seed, reseeds++);
+		Clear();
+
+		FOR_LS
+			int ppn = Target(levelSet, i, j, k);
+			if(ppn > 0) {
+				if(n + ppn > SAMPLE_BATCH) { AddSampled<Interp>(levelSet, x, y, z, phis, n); n = 0; }
+				philox.Uniform(Cell(i,j,k), 0, ppn, x+n, y+n, z+n);
+				for(int p=0; p < ppn; p++, n++) { x[n] += i; y[n] += j; z[n] += k; }
+			}
+        END_FOR_THREE
+		AddSampled<Interp>(levelSet, x, y, z, phis, n);
+	}
+
+	void TopUp(const LevelSet& levelSet, Interpolation interp = INTERP_LINEAR)
+	{
+		switch(interp) {
+		case INTERP_CUBIC:		 TopUp<CubicInterpolation>(levelSet); break;
+		case INTERP_CATMULL_ROM: TopUp<CatmullRomInterpolation>(levelSet); break;
+		default:				 TopUp<LinearInterpolation>(levelSet); break;
+		}
+	}
+	template<class Interp>
+	void TopUp(const LevelSet& levelSet)
+	{
+		cellTarget.assign((Nx+2)*(Ny+2)*(Nz+2), 0);
+		cellCount.assign(cellTarget.size(), 0);
+
+		ParticleTargets targets;
+		targets.set = this;
+		targets.levelSet = &levelSet;
+		ParallelFor(TaskPool::Shared(), 1, Nz+1, 1, targets);
 
+		Trim();
 
-/*
-	ParticleSet: A class for representing the set of particles used in error correcting the Level Set
-	Inputs: Size of grid and cell
-			
-	This class only stores a list with pointers to all the particles within the grid. Note that the
-	particles are not stored per cell, but for the entire grid. 
+		vector< vector<CompactParticle> > added(Nz+1);
+		Philox philox(seed, reseeds++);
+		ParticleTopUp<Interp> topUp;
+		topUp.set = this;
+		topUp.levelSet = &levelSet;
+		topUp.philox = &philox;
+		topUp.target = &cellTarget[0];
+		topUp.count = &cellCount[0];
+		topUp.added = &added[0];
+		topUp.hInv = hInv;
+		ParallelFor(TaskPool::Shared(), 1, Nz+1, 1, topUp);
+		for(int k = 1; k <= Nz; k++) particles.insert(particles.end(), added[k].begin(), added[k].end());
+	}
+
+	// keeps the first cellTarget particles of every cell (in array order), counts them into
+	// cellCount and deletes the rest. The particles are bucketed by slab k with a histogram
+	// per chunk and an exclusive prefix sum, as in Sort, and the slabs then decide in 
+	// parallel, each over its own cells
+	void Trim()
+	{
+		int n = Count();
+		if(n == 0) return;
+		int chunks = (n + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK, slabs = Nz + 2;
+		vector<int> offsets(chunks * slabs), starts(slabs + 1), order(n);
+		keep.resize(n);
+		ParticleTrim trim;
+		trim.set = this;
+		trim.offsets = &offsets[0];
+		trim.starts = &starts[0];
+		trim.order = &order[0];
+		trim.n = n;
+		trim.slabs = slabs;
+		trim.Run(chunks, ParticleTrim::COUNT);
+		// exclusive prefix sum over slabs first and chunks second, so that every slab lists
+		// its particles in array order
+		int sum = 0;
+		for(int s = 0; s < slabs; s++) {
+			starts[s] = sum;
+			for(int c = 0; c < chunks; c++) {
+				int count = offsets[c * slabs + s];
+				offsets[c * slabs + s] = sum;
+				sum += count;
+			}
+		}
+		starts[slabs] = sum;
+		trim.Run(chunks, ParticleTrim::SCATTER);
+		trim.Run(slabs, ParticleTrim::KEEP);
+		Compact(&keep[0]);
+	}
 
-	Functions:
-	Update		- takes as input a velocity grid and a timestep. Calls the update function for
-				  each partricle and removes it if the particle has exited the grid.
-	Resample	- Updates the radius for each particle. Only use this function is necessary
-	Reseed		- Deletes all particles and creates new ones. Only use this function when
-			      absolutely necessary
-				  
-	Created by Emud Mokhberi: UCLA : 09/04/04
-*/
+	void Compact(const unsigned char *keep)
+	{
+		int n = Count();
+		if(n == 0) return;
+		int chunks = (n + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+		vector<int> offsets(chunks + 1, 0);
+		ParticleCompact compact;
+		compact.particles = &particles[0];
+		compact.keep = keep;
+		compact.offsets = &offsets[0];
+		compact.n = n;
+		compact.Run(chunks, false);
+		for(int c = 0; c < chunks; c++) offsets[c+1] += offsets[c];
+		if(offsets[chunks] == n) return;
 
-#ifndef PARTICLESET_H
-#define PARTICLESET_H
+		vector<CompactParticle> kept(offsets[chunks]);
+		compact.kept = kept.empty() ? NULL : &kept[0];
+		compact.Run(chunks, true);
+		particles.swap(kept);
+	}
+
+	void Sort()
+	{
+		int n = Count();
+		if(n < 2) return;
+		int chunks = (n + PARTICLE_CHUNK - 1) / PARTICLE_CHUNK;
+		vector<unsigned int> keys(n), sortedKeys(n);
+		vector<CompactParticle> sorted(n);
+		vector<int> offsets(chunks * ParticleRadix::DIGITS);
+		ParticleRadix radix;
+		radix.from = &particles[0];
+		radix.to = &sorted[0];
+		radix.fromKeys = &keys[0];
+		radix.toKeys = &sortedKeys[0];
+		radix.offsets = &offsets[0];
+		radix.n = n;
+		radix.Run(chunks, ParticleRadix::KEYS);
 
-#include "main.h"
-#include "Vector.h"
+		bool swapped = false;
+		for(radix.shift = 0; radix.shift < 30; radix.shift += ParticleRadix::BITS) {
+			radix.Run(chunks, ParticleRadix::COUNT);
+			// exclusive prefix sum over digits first and chunks second, so that every chunk 
+			// scatters its particles of a digit after the ones of the chunks before it
+			int sum = 0;
+			bool skip = false;
+			for(int d = 0; d < ParticleRadix::DIGITS && !skip; d++) {
+				int first = sum;
+				for(int c = 0; c < chunks; c++) {
+					int count = offsets[c * ParticleRadix::DIGITS + d];
+					offsets[c * ParticleRadix::DIGITS + d] = sum;
+					sum += count;
+				}
+				skip = sum - first == n;	// all particles have the same digit
+			}
+			if(skip) continue;
+			radix.Run(chunks, ParticleRadix::SCATTER);
+			swap(radix.from, radix.to);
+			swap(radix.fromKeys, radix.toKeys);
+			swapped = !swapped;
+		}
+		if(swapped) particles.swap(sorted);
+	}
 
-#include "LevelSet.h"
-#include "Particle.h"
-#include "Velocity.h"
+	Double Disorder() const
+	{
+		if(Count() < 2) return 0;
+		ParticleDisorder disorder;
+		disorder.particles = &particles[0];
+		int unordered = ParallelReduce(TaskPool::Shared(), 1, Count(), PARTICLE_CHUNK, disorder, 0, 
+									   ParticleDisorder::Join);
+		return Double(unordered) / Count();
+	}
+
+	// number of particles Reseed puts into cell (i,j,k)
+	int Target(const LevelSet& levelSet, int i, int j, int k) const
+	{
+        bool reseed = false, reseed2 = false;
+		for(int dx=0; dx < 2; dx++) {
+			for(int dy=0; dy < 2; dy++) {
+				for(int dz=0; dz < 2; dz++) {
+				Double phi = abs(levelSet(i+dx,j+dy,k+dz));
+				if(phi < RESEED_THRESHOLD) reseed = true;
+				if(phi < h) reseed2 = true;
+				}
+			}
+		}
+		if(!reseed)  return 0;
+		if(reseed2)  return PARTICLES_PER_INTERFACE_NODE;
+		return PARTICLES_PER_NODE;
+	}
 
-class ParticleSet
-{
 private:
-	int Nx, Ny, Nz;
-	list<Particle*> particles;
-    Double h, hInv;
-public:
-	ParticleSet(int nx,int ny, int nz, Double hi) : Nx(nx), Ny(ny), Nz(nz), h(hi), hInv(1./hi) {}
-	~ParticleSet() 
-	{   for(Iterator it = particles.begin(); it != particles.end(); it++) delete *it; 
-        particles.clear(); }
-
-	typedef list<Particle*>::iterator Iterator;
-	typedef list<Particle*>::const_iterator cIterator;
-	cIterator begin() const { return particles.begin(); }
-	cIterator end()   const { return particles.end(); }
-
-	void Update(const Velocity& grid, const Double &dt)
+	// index of cell (i,j,k) in cellTarget and cellCount, and the Philox stream of its 
+	// particles. Unlike Grid::Index it does not depend on the buffer width of the level set
+	inline int Cell(int i, int j, int k) const { return i + (Nx+2) * (j + (Ny+2) * k); }
+
+	// cell targets of the slabs k = begin ... end-1
+	struct ParticleTargets
 	{
-        static Particle* p;
-        static Vector pos;
-		for(Iterator it = particles.begin(); it != particles.end();)
+		ParticleSet *set;
+		const LevelSet *levelSet;
+		void operator()(int begin, int end) const
 		{
-			p = *it;
-            p->Update(grid, dt, hInv);
-			p->GetPosition(pos);
-
-			if( pos[0] < 0 || pos[0] > Nx+1 || 
-                pos[1] < 0 || pos[1] > Ny+1 ||
-                pos[2] < 0 || pos[2] > Nz+1) { it = particles.erase(it); delete p; }
-			else it++;
+			for(int k = begin; k < end; k++)
+				for(int j = 1; j <= set->Ny; j++)
+					for(int i = 1; i <= set->Nx; i++)
+						set->cellTarget[set->Cell(i,j,k)] = set->Target(*levelSet, i, j, k);
 		}
-	}
-	void Resample(const LevelSet& levelSet) // updates particle radii;
+	};
+
+	// creates the missing particles of the cells in the slabs k = begin ... end-1. Each slab
+	// gets its own list, so they can be added in slab order
+	template<class Interp>
+	struct ParticleTopUp
 	{
-		static Vector pos;
-        Particle *p;
-		for(Iterator it = particles.begin(); it != particles.end();) 
+		const ParticleSet *set;
+		const LevelSet *levelSet;
+		const Philox *philox;
+		const int *target, *count;
+		vector<CompactParticle> *added;
+		Double hInv;
+		void operator()(int begin, int end) const
 		{
-			p = *it;
-			p->GetPosition(pos);
-			if(p->SetRadius(levelSet.SAMPLEPHI(pos), hInv)) it++;
-			else { it = particles.erase(it); delete p; }
+			Double x[SAMPLE_BATCH], y[SAMPLE_BATCH], z[SAMPLE_BATCH], phi[SAMPLE_BATCH];
+			const Grid &grid = levelSet->GetPhi();
+			for(int k = begin; k < end; k++) {
+				int n = 0;
+				for(int j = 1; j <= grid.GetNy(); j++)
+					for(int i = 1; i <= grid.GetNx(); i++) {
+						int cell = set->Cell(i,j,k);
+						int missing = target[cell] - count[cell];
+						if(missing <= 0) continue;
+						if(n + missing > SAMPLE_BATCH) { Add(x, y, z, phi, n, added[k]); n = 0; }
+						philox->Uniform(cell, count[cell], missing, x+n, y+n, z+n);
+						for(; missing > 0; missing--, n++) { x[n] += i; y[n] += j; z[n] += k; }
+					}
+				Add(x, y, z, phi, n, added[k]);
+			}
 		}
-	}
-	void Reseed(const LevelSet& levelSet)	 // deletes particles and creates new ones
+		void Add(const Double *x, const Double *y, const Double *z, Double *phi, int n,
+				 vector<CompactParticle> &to) const
+		{
+			levelSet->Sample<Interp>(x, y, z, n, phi);
+			for(int p = 0; p < n; p++) to.push_back(Particle(Vector(x[p], y[p], z[p]), phi[p], hInv));
+		}
+	};
+
+	// the passes of Trim. COUNT counts the particles of every slab in the chunks begin ... 
+	// end-1 of PARTICLE_CHUNK particles into offsets, SCATTER lists their indices from the 
+	// offsets of their slabs on in order, and KEEP sets the keep flags of the particles of 
+	// the slabs begin ... end-1, which only touches the cellCount of their own cells
+	struct ParticleTrim
 	{
-        static Double phi, ppn; 
-        static bool reseed, reseed2;
-		for(Iterator it = particles.begin(); it != particles.end(); it++) delete *it;
-		particles.clear();
-
-		FOR_LS
-			reseed = false;
-            reseed2 = false; 
-            for(int dx=0; dx < 2; dx++) {
-                for(int dy=0; dy < 2; dy++) {
-                    for(int dz=0; dz < 2; dz++) {
-                    phi = abs(levelSet(i+dx,j+dy,k+dz));
-					if(phi < RESEED_THRESHOLD) reseed = true;
-                    if(phi < h) reseed2 = true;
-                    }
-                }
-            }
-            if(reseed2) ppn = PARTICLES_PER_INTERFACE_NODE;
-            else        ppn = PARTICLES_PER_NODE;
-			if(reseed) {
-				for(int x=0; x < ppn; x++) {
-					Vector pos(Double(i) + RandomFloat(), 
-							   Double(j) + RandomFloat(),
-                               Double(k) + RandomFloat());
-					particles.push_back(new Particle(pos, levelSet.SAMPLEPHI(pos), hInv));
+		enum Pass { COUNT, SCATTER, KEEP };
+		ParticleSet *set;
+		int *offsets, *starts, *order;
+		int n, slabs;
+		Pass pass;
+		void Run(int tasks, Pass p) { pass = p; ParallelFor(TaskPool::Shared(), 0, tasks, 1, *this); }
+		void operator()(int begin, int end) const
+		{
+			const CompactParticle *particles = &set->particles[0];
+			int i, j, k;
+			if(pass == KEEP) {
+				for(int s = begin; s < end; s++)
+					for(int q = starts[s]; q < starts[s+1]; q++) {
+						int p = order[q];
+						particles[p].GetCell(i, j, k);
+						int cell = set->Cell(i, j, k);
+						set->keep[p] = set->cellCount[cell] < set->cellTarget[cell];
+						if(set->keep[p]) set->cellCount[cell]++;
+					}
+				return;
+			}
+			for(int c = begin; c < end; c++) {
+				int first = c * PARTICLE_CHUNK, last = min(n, first + PARTICLE_CHUNK);
+				int *offset = offsets + c * slabs;
+				if(pass == COUNT) {
+					for(int s = 0; s < slabs; s++) offset[s] = 0;
+					for(int p = first; p < last; p++) { particles[p].GetCell(i, j, k); offset[k]++; }
 				}
+				else
+					for(int p = first; p < last; p++) { particles[p].GetCell(i, j, k); order[offset[k]++] = p; }
 			}
-               
-        END_FOR_THREE
-	}
-};
+		}
+	};
+
+	// updates the radii of the particles begin ... end-1 and flags the ones to delete
+	template<class Interp>
+	struct ParticleResample
+	{
+		const LevelSet *levelSet;
+		CompactParticle *particles;
+		unsigned char *keep;
+		Double hInv;
+		void operator()(int begin, int end) const
+		{
+			Double x[SAMPLE_BATCH], y[SAMPLE_BATCH], z[SAMPLE_BATCH], phi[SAMPLE_BATCH];
+			Vector pos;
+			for(int first = begin; first < end; first += SAMPLE_BATCH) {
+				int n = min(SAMPLE_BATCH, end - first);
+				for(int p = 0; p < n; p++) {
+					particles[first+p].GetPosition(pos);
+					x[p] = pos[0]; y[p] = pos[1]; z[p] = pos[2];
+				}
+				levelSet->Sample<Interp>(x, y, z, n, phi);
+				for(int p = 0; p < n; p++) keep[first+p] = particles[first+p].SetRadius(phi[p], hInv);
+			}
+		}
+	};
 
+	// the two passes of Compact over the chunks begin ... end-1 of PARTICLE_CHUNK particles.
+	// The first counts the survivors of every chunk into offsets[c+1], the second copies them
+	// to kept from offsets[c] on
+	struct ParticleCompact
+	{
+		CompactParticle *particles, *kept;
+		const unsigned char *keep;
+		int *offsets;
+		int n;
+		bool scatter;
+		void Run(int chunks, bool s) { scatter = s; ParallelFor(TaskPool::Shared(), 0, chunks, 1, *this); }
+		void operator()(int begin, int end) const
+		{
+			for(int c = begin; c < end; c++) {
+				int last = min(n, (c+1) * PARTICLE_CHUNK);
+				if(!scatter) {
+					int count = 0;
+					for(int p = c * PARTICLE_CHUNK; p < last; p++) count += keep[p] != 0;
+					offsets[c+1] = count;
+					continue;
+				}
+				CompactParticle *to = kept + offsets[c];
+				for(int p = c * PARTICLE_CHUNK; p < last; p++) {
+					if(keep[p]) *to++ = particles[p];
+				}
+			}
+		}
+	};
+
+	// the passes of Sort over the chunks begin ... end-1 of PARTICLE_CHUNK particles. KEYS
+	// fills fromKeys with the Morton codes of from, COUNT counts the digits at shift of every 
+	// chunk into offsets, and SCATTER moves the particles and keys of every chunk to the 
+	// offsets of their digits in to and toKeys
+	struct ParticleRadix
+	{
+		enum { BITS = 8, DIGITS = 1 << BITS };
+		enum Pass { KEYS, COUNT, SCATTER };
+		CompactParticle *from, *to;
+		unsigned int *fromKeys, *toKeys;
+		int *offsets;
+		int n, shift;
+		Pass pass;
+		void Run(int chunks, Pass p) { pass = p; ParallelFor(TaskPool::Shared(), 0, chunks, 1, *this); }
+		void operator()(int begin, int end) const
+		{
+			for(int c = begin; c < end; c++) {
+				int first = c * PARTICLE_CHUNK, last = min(n, first + PARTICLE_CHUNK);
+				int *offset = offsets + c * DIGITS;
+				if(pass == KEYS) 
+					for(int p = first; p < last; p++) fromKeys[p] = from[p].Morton();
+				else if(pass == COUNT) {
+					for(int d = 0; d < DIGITS; d++) offset[d] = 0;
+					for(int p = first; p < last; p++) offset[(fromKeys[p] >> shift) & (DIGITS-1)]++;
+				}
+				else 
+					for(int p = first; p < last; p++) {
+						int slot = offset[(fromKeys[p] >> shift) & (DIGITS-1)]++;
+						to[slot] = from[p];
+						toKeys[slot] = fromKeys[p];
+					}
+			}
+		}
+	};
+
+	// counts the particles begin ... end-1 whose cell comes before the one of the particle 
+	// before them in Morton order
+	struct ParticleDisorder
+	{
+		const CompactParticle *particles;
+		int operator()(int begin, int end) const
+		{
+			int unordered = 0;
+			unsigned int last = particles[begin-1].Morton();
+			for(int p = begin; p < end; p++) {
+				unsigned int code = particles[p].Morton();
+				if(code < last) unordered++;
+				last = code;
+			}
+			return unordered;
+		}
+		static int Join(int a, int b) { return a + b; }
+	};
+
+	vector<int> cellTarget, cellCount;	// scratch of TopUp
+	vector<unsigned char> keep;			// keep flags of the particles, scratch of Compact's callers
+};
+
 #endif
\ No newline at end of file
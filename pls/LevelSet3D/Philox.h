@@ -0,0 +1,117 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+/*
+	Philox: Counter-based random numbers (Philox4x32-10, Salmon et al., "Parallel random
+	numbers: as easy as 1, 2, 3", SC 2011)
+
+	The generator has no state that changes. Each call maps a key and a counter through ten 
+	rounds of multiplications and xors to four 32 bit numbers, so any thread can produce the
+	numbers for any counter independently and always gets the same ones. The key is made 
+	from a seed and a frame (the reseed count of a ParticleSet, for instance), the counter
+	from a cell index and a particle slot within the cell.
+
+	Functions:
+	Generate	- the four 32 bit numbers for counter (c0,c1,c2,c3)
+	Uniform		- positions in [0,1)^3 for the particle slots first ... first+n-1 of a cell.
+				  Four slots are generated at once in the structure of arrays layout, 
+				  which the compiler can map to SIMD instructions. The result of a slot 
+				  does not depend on n or first
+*/
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include "main.h"
+
+class Philox
+{
+public:
+	Philox(unsigned int seed = 4357, unsigned int frame = 0) : k0(seed), k1(frame) {}
+
+	inline void Generate(unsigned int c0, unsigned int c1, unsigned int c2, unsigned int c3,
+						 unsigned int out[4]) const
+	{
+		unsigned int key0 = k0, key1 = k1;
+		for(int r = 0; r < ROUNDS; r++) {
+			unsigned long long p0 = (unsigned long long) M0 * c0;
+			unsigned long long p1 = (unsigned long long) M1 * c2;
+			unsigned int hi0 = (unsigned int) (p0 >> 32), lo0 = (unsigned int) p0;
+			unsigned int hi1 = (unsigned int) (p1 >> 32), lo1 = (unsigned int) p1;
+			c0 = hi1 ^ c1 ^ key0;
+			c1 = lo1;
+			c2 = hi0 ^ c3 ^ key1;
+			c3 = lo0;
+			key0 += W0; key1 += W1;
+		}
+		out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+	}
+
+	void Uniform(unsigned int cell, int first, int n, Double *x, Double *y, Double *z) const
+	{
+		const Double scale = 1. / 4294967296.;
+		unsigned int out[4];
+		int slot = first, end = first + n;
+		for(; slot + LANES <= end; slot += LANES, x += LANES, y += LANES, z += LANES) {
+			unsigned int c0[LANES], c1[LANES], c2[LANES], c3[LANES];
+			for(int l = 0; l < LANES; l++) { c0[l] = slot + l; c1[l] = cell; c2[l] = c3[l] = 0; }
+			unsigned int key0 = k0, key1 = k1;
+			for(int r = 0; r < ROUNDS; r++) {
+				for(int l = 0; l < LANES; l++) {
+					unsigned long long p0 = (unsigned long long) M0 * c0[l];
+					unsigned long long p1 = (unsigned long long) M1 * c2[l];
+					c0[l] = (unsigned int) (p1 >> 32) ^ c1[l] ^ key0;
+					c1[l] = (unsigned int) p1;
+					c2[l] = (unsigned int) (p0 >> 32) ^ c3[l] ^ key1;
+					c3[l] = (unsigned int) p0;
+				}
+				key0 += W0; key1 += W1;
+			}
+			for(int l = 0; l < LANES; l++) {
+				x[l] = c0[l] * scale;
+				y[l] = c1[l] * scale;
+				z[l] = c2[l] * scale;
+			}
+		}
+		for(; slot < end; slot++, x++, y++, z++) {
+			Generate(slot, cell, 0, 0, out);
+			*x = out[0] * scale;
+			*y = out[1] * scale;
+			*z = out[2] * scale;
+		}
+	}
+
+private:
+	enum { ROUNDS = 10, LANES = 4 };
+	static const unsigned int M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+	static const unsigned int W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+	unsigned int k0, k1;
+};
+
+#endif
@@ -0,0 +1,80 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+/*
+	ReseedPolicy: Deciding after each step whether the particles have to be reseeded
+
+	Decide looks at the FixStatistics of a step and returns
+	RESEED_NONE		- nothing happened that needs new particles
+	RESEED_LOCAL	- ParticleSet::TopUp, if more than topUpEscaped of the particles escaped,
+					  more than topUpDeficient of the band cells are short of particles, or 
+					  interval steps have passed since the last reseed
+	RESEED_FULL		- ParticleSet::Reseed, if more than reseedDeficient of the band cells are
+					  short of particles (the interface has torn or moved far)
+
+	A threshold or interval of 0 turns that trigger off. The default policy never reseeds,
+	an interval of 1 tops up every step.
+*/
+
+#ifndef RESEEDPOLICY_H
+#define RESEEDPOLICY_H
+
+#include "main.h"
+#include "LevelSet.h"
+
+class ReseedPolicy
+{
+public:
+	enum Action { RESEED_NONE, RESEED_LOCAL, RESEED_FULL };
+
+	ReseedPolicy(Double escaped = 0, Double deficient = 0, Double full = 0, int every = 0)
+		: topUpEscaped(escaped), topUpDeficient(deficient), reseedDeficient(full), 
+		  interval(every), steps(0) {}
+
+	Action Decide(const FixStatistics &stats)
+	{
+		steps++;
+		Double escaped = stats.particles > 0 ? Double(stats.escaped) / stats.particles : 0;
+		Double deficient = stats.band > 0 ? Double(stats.deficient) / stats.band : 0;
+		Action action = RESEED_NONE;
+		if(reseedDeficient > 0 && deficient > reseedDeficient) action = RESEED_FULL;
+		else if((topUpEscaped > 0 && escaped > topUpEscaped) || 
+				(topUpDeficient > 0 && deficient > topUpDeficient) ||
+				(interval > 0 && steps >= interval)) action = RESEED_LOCAL;
+		if(action != RESEED_NONE) steps = 0;
+		return action;
+	}
+
+	Double topUpEscaped, topUpDeficient, reseedDeficient;
+	int interval;
+
+private:
+	int steps;	// since the last reseed
+};
+
+#endif
@@ -0,0 +1,103 @@
+/*
+	StressTest: Runs several Containers at the same time and checks them against serial runs
+
+	Each Container gets its own seed and correction Interpolation and is stepped STEPS times,
+	first one after the other and then all at once on their own threads (sharing the
+	TaskPool). Every concurrent run has to end with the same level set, compared cell by 
+	cell over the whole buffer, and the same particles, compared bit for bit (cell, offsets,
+	sign and radius) in array order, as its serial run. Returns 0 if they all do and 1 
+	otherwise.
+
+	Usage: StressTest [containers] [steps] [threads]
+*/
+
+#include "Container.h"
+#include "Thread.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct StressResult
+{
+	vector<Double> phi;					// the whole buffer of the level set grid
+	vector<CompactParticle> particles;
+};
+
+struct StressJob
+{
+	Container *contain;
+	int steps;
+	StressResult result;
+};
+
+static void Restart(Container &contain, int index)
+{
+	contain.correction = Interpolation(index % INTERPOLATIONS);
+	contain.pset.SetSeed(100 + index);
+	contain.Clear();
+}
+
+static void RunJob(void *arg)
+{
+	StressJob &job = *(StressJob*) arg;
+	for(int s = 0; s < job.steps; s++) job.contain->Update();
+	const Grid &phi = job.contain->lset.GetPhi();
+	int nx, ny, nz, size;
+	phi.GetSize(nx, ny, nz, size);
+	job.result.phi.assign(&phi[0], &phi[0] + size);
+	job.result.particles.assign(job.contain->pset.begin(), job.contain->pset.end());
+}
+
+// number of cells, and of particles, in which a differs from b
+static void Compare(const StressResult &a, const StressResult &b, int &cells, int &particles)
+{
+	cells = 0;
+	for(size_t i = 0; i < a.phi.size(); i++) 
+		if(a.phi[i] != b.phi[i]) cells++;
+	size_t n = min(a.particles.size(), b.particles.size());
+	particles = int(max(a.particles.size(), b.particles.size()) - n);
+	for(size_t p = 0; p < n; p++)
+		if(memcmp(&a.particles[p], &b.particles[p], sizeof(CompactParticle)) != 0) particles++;
+}
+
+int main(int argc, char **argv)
+{
+	int numContainers = argc > 1 ? atoi(argv[1]) : 4;
+	int steps = argc > 2 ? atoi(argv[2]) : 4;
+	TaskPool::Configure(argc > 3 ? atoi(argv[3]) : 0);
+
+	vector<StressJob> jobs(numContainers);
+	vector<StressResult> serial(numContainers);
+	for(int c = 0; c < numContainers; c++) {
+		jobs[c].contain = new Container(NX,NY,NZ,HH);
+		jobs[c].steps = steps;
+		Restart(*jobs[c].contain, c);
+		RunJob(&jobs[c]);
+		serial[c].phi.swap(jobs[c].result.phi);
+		serial[c].particles.swap(jobs[c].result.particles);
+		Restart(*jobs[c].contain, c);
+	}
+
+	Thread *threads = new Thread[numContainers];
+	bool started = true;
+	for(int c = 0; c < numContainers && started; c++) 
+		if(!threads[c].Start(RunJob, &jobs[c])) {
+			cerr << "couldn't start thread " << c << endl;
+			started = false;
+		}
+	delete [] threads;	// joins them
+	if(!started) return 1;
+
+	int failed = 0;
+	for(int c = 0; c < numContainers; c++) {
+		int cells, particles;
+		Compare(serial[c], jobs[c].result, cells, particles);
+		bool same = cells == 0 && particles == 0;
+		printf("container %d: %d particles, %d cells and %d particles differ %s\n", c, 
+			   int(serial[c].particles.size()), cells, particles, same ? "ok" : "MISMATCH");
+		if(!same) failed++;
+		delete jobs[c].contain;
+	}
+	printf("%d of %d containers differ\n", failed, numContainers);
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+#include "TaskGraph.h"
+
+int TaskGraph::Add(Task *task)
+{
+	NodeTask node;
+	node.graph = this;
+	node.task = task;
+	node.dependencies = node.waiting = 0;
+	nodes.push_back(node);
+	return int(nodes.size()) - 1;
+}
+
+void TaskGraph::Depend(int node, int on)
+{
+	nodes[on].next.push_back(node);
+	nodes[node].dependencies++;
+}
+
+void TaskGraph::Run(TaskPool &p)
+{
+	TaskGroup done;
+	pool = &p;
+	group = &done;
+	for(size_t n = 0; n < nodes.size(); n++) {
+		nodes[n].graph = this;
+		nodes[n].waiting = nodes[n].dependencies;
+	}
+	// collect the roots first, a pool without workers runs them (and their successors) in Spawn
+	vector<int> roots;
+	for(size_t n = 0; n < nodes.size(); n++)
+		if(nodes[n].dependencies == 0) roots.push_back(int(n));
+	for(size_t r = 0; r < roots.size(); r++) pool->Spawn(&nodes[roots[r]], done);
+	pool->Wait(done);
+}
+
+void TaskGraph::NodeTask::Run()
+{
+	task->Run();
+	graph->Finished(*this);
+}
+
+void TaskGraph::Finished(NodeTask &node)
+{
+	vector<int> ready;
+	{
+		MutexLock lock(mutex);
+		for(size_t n = 0; n < node.next.size(); n++)
+			if(--nodes[node.next[n]].waiting == 0) ready.push_back(node.next[n]);
+	}
+	for(size_t r = 0; r < ready.size(); r++) pool->Spawn(&nodes[ready[r]], *group);
+}
@@ -0,0 +1,88 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	TaskGraph: Running a set of tasks that depend on each other on a TaskPool
+
+	Add registers a task and returns its node. Depend(node, on) makes node wait for on.
+	Run spawns every node without dependencies and, whenever a node finishes, the nodes
+	that were only waiting for it. It returns once every node has run. Tasks that do not
+	depend on each other run at the same time, and tasks may use ParallelFor on the same 
+	pool themselves.
+
+	The graph does not own its tasks. A graph can be run more than once.
+
+	MethodTask calls a member function without arguments, which is enough for building 
+	graphs out of the stages of a class.
+*/
+
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include "main.h"
+#include "TaskPool.h"
+
+class TaskGraph
+{
+public:
+	int Add(Task *task);
+	void Depend(int node, int on);
+	void Run(TaskPool &pool);
+
+private:
+	class NodeTask : public Task
+	{
+	public:
+		void Run();
+		TaskGraph *graph;
+		Task *task;
+		vector<int> next;		// nodes that depend on this one
+		int dependencies, waiting;
+	};
+
+	void Finished(NodeTask &node);
+
+	vector<NodeTask> nodes;
+	TaskPool *pool;
+	TaskGroup *group;
+	Mutex mutex;				// guards waiting while the graph runs
+};
+
+template<class T>
+class MethodTask : public Task
+{
+public:
+	MethodTask(T *o, void (T::*m)()) : object(o), method(m) {}
+	void Run() { (object->*method)(); }
+private:
+	T *object;
+	void (T::*method)();
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include "TaskPool.h"
+
+TaskPool *TaskPool::shared = NULL;
+int TaskPool::sharedThreads = 0;
+bool TaskPool::sharedPin = false;
+
+TaskPool::TaskPool(int numThreads, bool pin)
+	: workers(NULL), numWorkers(0), queued(0), next(0), quit(false)
+{
+	if(numThreads <= 0) numThreads = NumProcessors();
+	int num = numThreads - 1;
+	if(num <= 0) return;
+
+	workers = new Worker[num];
+	for(int w = 0; w < num; w++) {
+		workers[w].pool = this;
+		workers[w].index = w;
+	}
+	// numWorkers only counts started threads, tasks are only dealt to them
+	for(int w = 0; w < num; w++) {
+		if(!workers[w].thread.Start(Run, &workers[w])) break;
+		if(pin) workers[w].thread.Pin(w + 1);
+		MutexLock lock(mutex);
+		numWorkers++;
+	}
+}
+
+TaskPool::~TaskPool()
+{
+	mutex.Lock();
+	quit = true;
+	changed.Broadcast();
+	mutex.Unlock();
+	for(int w = 0; w < numWorkers; w++) workers[w].thread.Join();
+	delete [] workers;
+}
+
+// the shared pool is never deleted: static objects (a FramePipeline, for instance) may still
+// run kernels on it while the program exits
+TaskPool& TaskPool::Shared()
+{
+	if(shared == NULL) shared = new TaskPool(sharedThreads, sharedPin);
+	return *shared;
+}
+
+void TaskPool::Configure(int numThreads, bool pin)
+{
+	delete shared;
+	sharedThreads = numThreads;
+	sharedPin = pin;
+	shared = new TaskPool(sharedThreads, sharedPin);
+}
+
+void TaskPool::Spawn(Task *task, TaskGroup &group)
+{
+	task->group = &group;
+	if(numWorkers == 0) {
+		task->Run();
+		return;
+	}
+
+	// the task is pushed and counted under the pool mutex, so a thief that takes it right 
+	// away can only count it off after queued++ (queued never drops below 0)
+	MutexLock lock(mutex);
+	group.remaining++;
+	int w = next;
+	next = (next + 1) % numWorkers;
+	{
+		MutexLock taskLock(workers[w].mutex);
+		workers[w].tasks.push_back(task);
+	}
+	queued++;
+	changed.Broadcast();
+}
+
+void TaskPool::Wait(TaskGroup &group)
+{
+	for(;;) {
+		{
+			MutexLock lock(mutex);
+			if(group.remaining == 0) return;
+		}
+		Task *task = Take(-1);
+		if(task != NULL) {
+			Execute(task);
+			continue;
+		}
+		MutexLock lock(mutex);
+		while(group.remaining > 0 && queued == 0) changed.Wait(mutex);
+	}
+}
+
+void TaskPool::Run(void *worker)
+{
+	Worker *w = (Worker*) worker;
+	w->pool->Work(w->index);
+}
+
+void TaskPool::Work(int index)
+{
+	for(;;) {
+		Task *task = Take(index);
+		if(task != NULL) {
+			Execute(task);
+			continue;
+		}
+		MutexLock lock(mutex);
+		while(queued == 0 && !quit) changed.Wait(mutex);
+		if(quit) return;
+	}
+}
+
+// newest task of worker index, else the oldest task of any other worker. index -1 only steals
+Task* TaskPool::Take(int index)
+{
+	Task *task = NULL;
+	if(index >= 0) {
+		MutexLock lock(workers[index].mutex);
+		if(!workers[index].tasks.empty()) {
+			task = workers[index].tasks.back();
+			workers[index].tasks.pop_back();
+		}
+	}
+	for(int i = 1; task == NULL && i <= numWorkers; i++) {
+		Worker &victim = workers[(index + i + numWorkers) % numWorkers];
+		MutexLock lock(victim.mutex);
+		if(!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+		}
+	}
+	if(task != NULL) {
+		MutexLock lock(mutex);
+		queued--;
+	}
+	return task;
+}
+
+void TaskPool::Execute(Task *task)
+{
+	TaskGroup *group = task->group;
+	task->Run();
+	MutexLock lock(mutex);
+	if(--group->remaining == 0) changed.Broadcast();
+}
@@ -0,0 +1,212 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	TaskPool: A work-stealing pool of worker threads
+
+	Every worker has its own task queue. Spawned tasks are dealt out over the queues; a 
+	worker takes the newest task from its own queue and, when that is empty, steals the 
+	oldest one from another queue. A thread that waits for a TaskGroup runs queued tasks 
+	in the meantime, so tasks may spawn and wait for other tasks (ParallelFor inside a 
+	TaskGraph stage) without blocking a worker.
+
+	A pool for numThreads threads starts numThreads-1 workers, since the waiting thread 
+	does work as well. 0 means one thread per processor. A pool for 1 thread has no workers
+	and runs every task inside Spawn, which is the serial mode for debugging. With pin set,
+	worker w is kept on processor w+1 (the first one is left to the waiting thread).
+
+	Tasks are not owned by the pool and have to stay alive until their group is done.
+
+	TaskPool:
+	Spawn			- queues a task as part of a group
+	Wait			- runs tasks until every task of the group has finished
+	NumThreads		- number of threads that run tasks, including the waiting thread
+	Shared			- the pool every parallel kernel of the library runs on. Created on 
+					  first use, or by Configure. Any number of threads may run kernels on
+					  it at the same time (several Containers, for instance), but the first
+					  call must not race with another one
+	Configure		- creates the shared pool with the given thread count and pinning. 
+					  Replaces the pool if it exists already, so it must not be called while
+					  the pool is in use. Call it before starting threads of your own
+
+	ParallelFor		- splits [begin, end) into chunks of at least grain items and calls
+					  body(chunkBegin, chunkEnd) for each of them on the pool. The body
+					  must be safe to call concurrently for disjoint chunks. Grid kernels
+					  usually run over z-slabs, particle kernels over particle indices
+	ParallelReduce	- the same for body(chunkBegin, chunkEnd) returning a partial result, 
+					  which are combined with join(a, b) starting from identity. The chunks
+					  depend on the range and grain only, and are joined in order, so the 
+					  result does not depend on the number of threads
+*/
+
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include "main.h"
+#include "Thread.h"
+
+class TaskGroup;
+
+class Task
+{
+public:
+	Task() : group(NULL) {}
+	virtual ~Task() {}
+	virtual void Run() = 0;
+private:
+	friend class TaskPool;
+	TaskGroup *group;
+};
+
+// counts the unfinished tasks spawned with it
+class TaskGroup
+{
+public:
+	TaskGroup() : remaining(0) {}
+private:
+	friend class TaskPool;
+	int remaining;
+};
+
+class TaskPool
+{
+public:
+	TaskPool(int numThreads = 0, bool pin = false);
+	~TaskPool();
+
+	void Spawn(Task *task, TaskGroup &group);
+	void Wait(TaskGroup &group);
+	inline int NumThreads() const { return numWorkers + 1; }
+
+	static TaskPool& Shared();
+	static void Configure(int numThreads, bool pin = false);
+
+private:
+	TaskPool(const TaskPool&);
+	TaskPool& operator=(const TaskPool&);
+
+	struct Worker
+	{
+		TaskPool *pool;
+		int index;
+		Thread thread;
+		Mutex mutex;			// guards tasks. Spawn locks it inside the pool mutex
+		deque<Task*> tasks;
+	};
+
+	static void Run(void *worker);
+	void Work(int index);
+	Task* Take(int index);
+	void Execute(Task *task);
+
+	Worker *workers;
+	int numWorkers;
+	Mutex mutex;				// guards queued, next, quit and every TaskGroup
+	Condition changed;			// broadcast when a task is queued, a group is done or on quit
+	int queued, next;
+	bool quit;
+
+	static TaskPool *shared;
+	static int sharedThreads;
+	static bool sharedPin;
+};
+
+template<class Body>
+class RangeTask : public Task
+{
+public:
+	RangeTask() : body(NULL), begin(0), end(0) {}
+	void Run() { (*body)(begin, end); }
+	const Body *body;
+	int begin, end;
+};
+
+template<class Body>
+void ParallelFor(TaskPool &pool, int begin, int end, int grain, const Body &body)
+{
+	int n = end - begin;
+	if(n <= 0) return;
+	grain = max(grain, 1);
+	int chunks = min((n + grain - 1) / grain, 4 * pool.NumThreads());
+	if(chunks <= 1 || pool.NumThreads() == 1) {
+		body(begin, end);
+		return;
+	}
+
+	vector< RangeTask<Body> > tasks(chunks);
+	TaskGroup group;
+	for(int c = 0; c < chunks; c++) {
+		tasks[c].body = &body;
+		tasks[c].begin = begin + int((long long) n * c / chunks);
+		tasks[c].end = begin + int((long long) n * (c+1) / chunks);
+		if(c > 0) pool.Spawn(&tasks[c], group);
+	}
+	tasks[0].Run();
+	pool.Wait(group);
+}
+
+const int REDUCE_MAX_CHUNKS = 256;
+
+template<class Body, class T>
+class ReduceTask : public Task
+{
+public:
+	explicit ReduceTask(const T &identity) : body(NULL), begin(0), end(0), result(identity) {}
+	void Run() { result = (*body)(begin, end); }
+	const Body *body;
+	int begin, end;
+	T result;
+};
+
+template<class Body, class T, class Join>
+T ParallelReduce(TaskPool &pool, int begin, int end, int grain, const Body &body, 
+				 const T &identity, Join join)
+{
+	int n = end - begin;
+	if(n <= 0) return identity;
+	grain = max(grain, 1);
+	int chunks = min((n + grain - 1) / grain, REDUCE_MAX_CHUNKS);
+
+	vector< ReduceTask<Body, T> > tasks(chunks, ReduceTask<Body, T>(identity));
+	TaskGroup group;
+	for(int c = 0; c < chunks; c++) {
+		tasks[c].body = &body;
+		tasks[c].begin = begin + int((long long) n * c / chunks);
+		tasks[c].end = begin + int((long long) n * (c+1) / chunks);
+		if(c > 0) pool.Spawn(&tasks[c], group);
+	}
+	tasks[0].Run();
+	pool.Wait(group);
+
+	T result = identity;
+	for(int c = 0; c < chunks; c++) result = join(result, tasks[c].result);
+	return result;
+}
+
+#endif
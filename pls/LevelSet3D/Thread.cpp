@@ -0,0 +1,201 @@
+#include "Thread.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+unsigned long __stdcall Thread::Entry(void* self)
+{
+	Thread* t = (Thread*) self;
+	t->func(t->arg);
+	return 0;
+}
+
+bool Thread::Start(ThreadFunc f, void* a)
+{
+	Join();
+	func = f;
+	arg = a;
+	handle = CreateThread(NULL, 0, Entry, this, 0, NULL);
+	running = (handle != NULL);
+	return running;
+}
+
+void Thread::Join()
+{
+	if(!running) return;
+	WaitForSingleObject((HANDLE) handle, INFINITE);
+	CloseHandle((HANDLE) handle);
+	running = false;
+}
+
+bool Thread::Pin(int processor)
+{
+	if(!running) return false;
+	DWORD_PTR mask = DWORD_PTR(1) << (processor % (8 * sizeof(DWORD_PTR)));
+	return SetThreadAffinityMask((HANDLE) handle, mask) != 0;
+}
+
+Mutex::Mutex()
+{
+	impl = new CRITICAL_SECTION;
+	InitializeCriticalSection((CRITICAL_SECTION*) impl);
+}
+
+Mutex::~Mutex()
+{
+	DeleteCriticalSection((CRITICAL_SECTION*) impl);
+	delete (CRITICAL_SECTION*) impl;
+}
+
+void Mutex::Lock()   { EnterCriticalSection((CRITICAL_SECTION*) impl); }
+void Mutex::Unlock() { LeaveCriticalSection((CRITICAL_SECTION*) impl); }
+
+// Windows before Vista has no condition variables. This is the generation count scheme of
+// Schmidt and Pyarali: a manual reset event is set to release waiters, and a waiter only 
+// leaves if it started waiting before the latest Signal or Broadcast (its generation is 
+// older) and a release is left. The last released waiter resets the event, under the lock so
+// that a Signal or Broadcast can't slip in between
+struct ConditionImpl
+{
+	CRITICAL_SECTION lock;		// guards the counts
+	HANDLE event;
+	int waiters;				// threads in Wait
+	int released;				// waiters released but not yet gone
+	unsigned int generation;	// counts Signal and Broadcast calls that released someone
+};
+
+Condition::Condition()
+{
+	ConditionImpl *c = new ConditionImpl;
+	InitializeCriticalSection(&c->lock);
+	c->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	c->waiters = 0;
+	c->released = 0;
+	c->generation = 0;
+	impl = c;
+}
+
+Condition::~Condition()
+{
+	ConditionImpl *c = (ConditionImpl*) impl;
+	CloseHandle(c->event);
+	DeleteCriticalSection(&c->lock);
+	delete c;
+}
+
+void Condition::Wait(Mutex &mutex)
+{
+	ConditionImpl *c = (ConditionImpl*) impl;
+	EnterCriticalSection(&c->lock);
+	c->waiters++;
+	unsigned int generation = c->generation;
+	LeaveCriticalSection(&c->lock);
+	mutex.Unlock();
+
+	for(;;) {
+		WaitForSingleObject(c->event, INFINITE);
+		EnterCriticalSection(&c->lock);
+		bool done = c->released > 0 && c->generation != generation;
+		LeaveCriticalSection(&c->lock);
+		if(done) break;
+	}
+
+	mutex.Lock();
+	EnterCriticalSection(&c->lock);
+	c->waiters--;
+	if(--c->released == 0) ResetEvent(c->event);
+	LeaveCriticalSection(&c->lock);
+}
+
+void Condition::Signal()
+{
+	ConditionImpl *c = (ConditionImpl*) impl;
+	EnterCriticalSection(&c->lock);
+	if(c->waiters > c->released) {
+		SetEvent(c->event);
+		c->released++;
+		c->generation++;
+	}
+	LeaveCriticalSection(&c->lock);
+}
+
+void Condition::Broadcast()
+{
+	ConditionImpl *c = (ConditionImpl*) impl;
+	EnterCriticalSection(&c->lock);
+	if(c->waiters > 0) {
+		SetEvent(c->event);
+		c->released = c->waiters;
+		c->generation++;
+	}
+	LeaveCriticalSection(&c->lock);
+}
+
+int NumProcessors()
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return max(1, (int) info.dwNumberOfProcessors);
+}
+
+#else
+//***********************************unix specific*********************************
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+void* Thread::Entry(void* self)
+{
+	Thread* t = (Thread*) self;
+	t->func(t->arg);
+	return NULL;
+}
+
+bool Thread::Start(ThreadFunc f, void* a)
+{
+	Join();
+	func = f;
+	arg = a;
+	running = (pthread_create(&handle, NULL, Entry, this) == 0);
+	return running;
+}
+
+void Thread::Join()
+{
+	if(!running) return;
+	pthread_join(handle, NULL);
+	running = false;
+}
+
+bool Thread::Pin(int processor)
+{
+	if(!running) return false;
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(processor % CPU_SETSIZE, &set);
+	return pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+Mutex::Mutex()        { pthread_mutex_init(&impl, NULL); }
+Mutex::~Mutex()       { pthread_mutex_destroy(&impl); }
+void Mutex::Lock()    { pthread_mutex_lock(&impl); }
+void Mutex::Unlock()  { pthread_mutex_unlock(&impl); }
+
+Condition::Condition()  { pthread_cond_init(&impl, NULL); }
+Condition::~Condition() { pthread_cond_destroy(&impl); }
+void Condition::Wait(Mutex &mutex) { pthread_cond_wait(&impl, &mutex.impl); }
+void Condition::Signal()    { pthread_cond_signal(&impl); }
+void Condition::Broadcast() { pthread_cond_broadcast(&impl); }
+
+int NumProcessors()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? int(n) : 1;
+}
+
+#endif
@@ -0,0 +1,136 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+/*
+	Thread: Minimal wrappers around native threads (Win32 threads or pthreads)
+
+	Thread:
+	Start			- runs func(arg) on a new thread. Returns false if the thread could 
+					  not be created, in which case the caller should run func itself
+	Join			- waits for the thread to finish. Called by the destructor if needed
+	Pin				- restricts the running thread to one processor. Returns false where 
+					  this is not supported
+
+	Mutex			- Lock/Unlock. MutexLock locks a mutex for the lifetime of the object
+	Condition		- condition variable used together with a locked Mutex. Wait may wake up
+					  spuriously, so it has to be called in a loop that checks the condition.
+					  On Windows it is built from an event (see Thread.cpp), so it runs on 
+					  XP and builds with the Platform SDK of VC2005
+	NumProcessors	- number of processors available to the process
+*/
+
+#ifndef THREAD_H
+#define THREAD_H
+
+#include "main.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef void (*ThreadFunc)(void* arg);
+
+class Thread
+{
+public:
+	Thread() : func(NULL), arg(NULL), running(false) {}
+	~Thread() { Join(); }
+
+	bool Start(ThreadFunc f, void* a);
+	void Join();
+	bool Pin(int processor);
+	inline bool Running() const { return running; }
+
+private:
+	Thread(const Thread&);
+	Thread& operator=(const Thread&);
+
+	ThreadFunc func;
+	void* arg;
+	bool running;
+#ifdef _WIN32
+	static unsigned long __stdcall Entry(void* self);
+	void* handle;	// HANDLE, kept out of the header to avoid including windows.h
+#else
+	static void* Entry(void* self);
+	pthread_t handle;
+#endif
+};
+
+class Mutex
+{
+public:
+	Mutex();
+	~Mutex();
+	void Lock();
+	void Unlock();
+
+private:
+	friend class Condition;
+	Mutex(const Mutex&);
+	Mutex& operator=(const Mutex&);
+#ifdef _WIN32
+	void* impl;		// CRITICAL_SECTION
+#else
+	pthread_mutex_t impl;
+#endif
+};
+
+class MutexLock
+{
+public:
+	MutexLock(Mutex &m) : mutex(m) { mutex.Lock(); }
+	~MutexLock() { mutex.Unlock(); }
+private:
+	MutexLock(const MutexLock&);
+	MutexLock& operator=(const MutexLock&);
+	Mutex &mutex;
+};
+
+class Condition
+{
+public:
+	Condition();
+	~Condition();
+	void Wait(Mutex &mutex);
+	void Signal();
+	void Broadcast();
+
+private:
+	Condition(const Condition&);
+	Condition& operator=(const Condition&);
+#ifdef _WIN32
+	void* impl;		// ConditionImpl
+#else
+	pthread_cond_t impl;
+#endif
+};
+
+int NumProcessors();
+
+#endif
@@ -28,8 +28,25 @@
 
 
 /*
-	Velocity2: A class that generates a rigib body rotation within the grid
-			   It is used for testing the functionality of the library
+	Velocity: The interface of the velocity fields used by the LevelSet and the particles.
+			  Positions are given in grid indices, velocities in world units.
+
+	GetVelocity		- returns the velocity at the given point
+	GetVelocities	- the same for n points at once. Fields that can do this faster than n 
+					  calls to GetVelocity override it
+	GetCellVelocity	- the velocity at the centre of cell (i,j,k), which some fields can 
+					  return faster than GetVelocity
+	SetTime			- time dependent fields return their velocities at this time from then
+					  on. Called by the Container at the start of every step, never while
+					  velocities are being looked up
+
+	A field that is declared steady (SetSteady) does not change over time. This lets the 
+	LevelSet cache its semi-lagrangian backtraces. Anything that changes the field has to 
+	call Modified (SetSteady does so itself), which invalidates such caches.
+
+	VortexVelocity: A class that generates a rigib body rotation within the grid
+					It is used for testing the functionality of the library
+	MACVelocity (MACVelocity.h) is a velocity grid for coupling to a fluid solver
 
 	Created by Emud Mokhberi: UCLA : 09/04/04
 */
@@ -43,17 +60,41 @@
 class Velocity
 {
 public:
-	Velocity(int x,int y)
+	Velocity() : steady(false), version(0) {}
+	virtual ~Velocity() {}
+
+	virtual void GetVelocity(const Vector &pos, Vector &u) const = 0;
+	virtual void GetVelocities(const Vector *pos, Vector *u, int n) const
+		{ for(int p = 0; p < n; p++) GetVelocity(pos[p], u[p]); }
+	virtual void GetCellVelocity(int i, int j, int k, Vector &u) const
+		{ GetVelocity(Vector(i,j,k), u); }
+	virtual void SetTime(Double t) {}
+
+	inline bool Steady() const { return steady; }
+	inline unsigned int Version() const { return version; }
+	inline void SetSteady(bool s) { steady = s; Modified(); }
+	inline void Modified() { version++; }
+
+private:
+	bool steady;
+	unsigned int version;	// changed by Modified
+};
+
+class VortexVelocity : public Velocity
+{
+public:
+	VortexVelocity(int x,int y)
 	{
 		xs = Double(x+2) * 0.5;
 		ys = Double(y+2) * 0.5;
 		c = M_PI / 314;
 	}
-	inline void GetVelocity(const Vector &pos, Vector &u) const
+	void GetVelocity(const Vector &pos, Vector &u) const
 	{
 		//vortex around 0,0,1
 		u = Vector( c * (ys - pos[1]), c * (pos[0] - xs), 0.);
 	}
+
 	Double xs,ys;
 	Double c;
 };
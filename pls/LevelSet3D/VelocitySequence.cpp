@@ -0,0 +1,281 @@
+#include "VelocitySequence.h"
+#include "MACVelocity.h"
+#include "MappedFile.h"
+#include "Checkpoint.h"
+#include <cstring>
+
+static const int PAGE_SIZE = 4096;
+static const int VELOCITY_BATCH = 64;
+
+static inline long long AlignUp(long long offset)
+{
+	return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+bool SaveVelocityFrame(const char *filename, const MACVelocity &field, Double time)
+{
+	const Grid *component[3] = { &field.U(), &field.V(), &field.W() };
+	int nx, ny, nz, size;
+	field.W().GetSize(nx, ny, nz, size);
+	nz--;
+
+	VelocityFrameHeader header;
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, "PLSVELF");
+	header.version = VELOCITY_FRAME_VERSION;
+	header.byteOrder = CHECKPOINT_BYTEORDER;
+	header.headerSize = sizeof(VelocityFrameHeader);
+	header.nx = nx; header.ny = ny; header.nz = nz;
+	header.time = time;
+	long long offset = AlignUp(sizeof(VelocityFrameHeader));
+	for(int c = 0; c < 3; c++) {
+		int cx, cy, cz;
+		component[c]->GetSize(cx, cy, cz, size);
+		header.offset[c] = offset;
+		header.count[c] = size;
+		offset = AlignUp(offset + size * (long long) sizeof(Double));
+	}
+
+	FILE *fp = fopen(filename, "wb");
+	if(fp == NULL) {
+		cerr << "couldn't open " << filename << " for writing" << endl;
+		return false;
+	}
+	static const char zeros[CHECKPOINT_ALIGN] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	offset = sizeof(header);
+	for(int c = 0; c < 3 && ok; c++) {
+		if(header.offset[c] > offset) fwrite(zeros, 1, size_t(header.offset[c] - offset), fp);
+		ok = fwrite(&(*component[c])[0], sizeof(Double), size_t(header.count[c]), fp) == 
+			 size_t(header.count[c]);
+		offset = header.offset[c] + header.count[c] * sizeof(Double);
+	}
+	if(fclose(fp) != 0) ok = false;
+	if(!ok) cerr << "couldn't write " << filename << endl;
+	return ok;
+}
+
+VelocitySequence::VelocitySequence()
+	: numFrames(0), nx(-1), ny(-1), nz(-1), start(0), interval(1), alpha(0), stalls(0), 
+	  requested(-1), quit(false)
+{
+}
+
+bool VelocitySequence::Open(const char *filePattern, int num)
+{
+	Close();
+	if(num < 2) {
+		cerr << "a velocity sequence needs at least two frames" << endl;
+		return false;
+	}
+	pattern = filePattern;
+	numFrames = num;
+	nx = ny = nz = -1;
+	if(!Load(0, frames[0]) || !Load(1, frames[1])) {
+		Close();
+		return false;
+	}
+	start = frames[0].time;
+	interval = frames[1].time - frames[0].time;
+	if(interval <= 0) {
+		cerr << pattern << ": frames are not in time order" << endl;
+		Close();
+		return false;
+	}
+	alpha = 0;
+	stalls = 0;
+	quit = false;
+	requested = -1;
+	// without a thread Take loads the frames itself
+	thread.Start(Run, this);
+	Request(2);
+	Modified();
+	return true;
+}
+
+void VelocitySequence::Close()
+{
+	if(thread.Running()) {
+		mutex.Lock();
+		quit = true;
+		changed.Broadcast();
+		mutex.Unlock();
+		thread.Join();
+	}
+	Release(frames[0]);
+	Release(frames[1]);
+	Release(ready);
+}
+
+void VelocitySequence::SetTime(Double t)
+{
+	if(!IsOpen()) return;
+	int want = Clamp(int(floor((t - start) / interval)), 0, numFrames - 2);
+
+	if(want < frames[0].index) {
+		// going back: load right away
+		Release(frames[0]);
+		Release(frames[1]);
+		if(!Load(want, frames[0]) || !Load(want + 1, frames[1])) {
+			cerr << pattern << ": lost frames " << want << " and " << want + 1 << endl;
+			Close();
+			return;
+		}
+		Request(want + 2);
+	}
+	while(frames[0].index < want) {
+		Frame next;
+		if(!Take(frames[1].index + 1, next)) {
+			stalls++;
+			break;
+		}
+		Release(frames[0]);
+		frames[0] = frames[1];
+		frames[1] = next;
+		Request(frames[1].index + 1);
+	}
+
+	alpha = Clamp((t - frames[0].time) / (frames[1].time - frames[0].time), 0., 1.);
+	Modified();
+}
+
+void VelocitySequence::GetVelocity(const Vector &pos, Vector &u) const
+{
+	Vector later;
+	frames[0].field->GetVelocity(pos, u);
+	frames[1].field->GetVelocity(pos, later);
+	u = u * (1 - alpha) + later * alpha;
+}
+
+void VelocitySequence::GetVelocities(const Vector *pos, Vector *u, int n) const
+{
+	Vector later[VELOCITY_BATCH];
+	for(int first = 0; first < n; first += VELOCITY_BATCH) {
+		int m = min(VELOCITY_BATCH, n - first);
+		frames[0].field->GetVelocities(pos + first, u + first, m);
+		frames[1].field->GetVelocities(pos + first, later, m);
+		for(int p = 0; p < m; p++) u[first+p] = u[first+p] * (1 - alpha) + later[p] * alpha;
+	}
+}
+
+void VelocitySequence::GetCellVelocity(int i, int j, int k, Vector &u) const
+{
+	Vector later;
+	frames[0].field->GetCellVelocity(i, j, k, u);
+	frames[1].field->GetCellVelocity(i, j, k, later);
+	u = u * (1 - alpha) + later * alpha;
+}
+
+// maps frame index. Sets the grid size if it is not known yet, otherwise checks it
+bool VelocitySequence::Load(int index, Frame &frame)
+{
+	frame.index = index;
+	vector<char> name(pattern.size() + 32);
+	sprintf(&name[0], pattern.c_str(), index);
+
+	MappedFile *file = new MappedFile;
+	if(!file->Open(&name[0], true)) {
+		delete file;
+		return false;
+	}
+	const VelocityFrameHeader &header = *(const VelocityFrameHeader*) file->Data();
+	bool ok = file->Size() >= sizeof(VelocityFrameHeader) && 
+			  strncmp(header.magic, "PLSVELF", 8) == 0 &&
+			  header.version == VELOCITY_FRAME_VERSION &&
+			  header.byteOrder == CHECKPOINT_BYTEORDER &&
+			  header.headerSize == sizeof(VelocityFrameHeader) &&
+			  (nx < 0 || (header.nx == nx && header.ny == ny && header.nz == nz));
+	long long expected[3] = {
+		(header.nx+3) * (long long) (header.ny+2) * (header.nz+2),
+		(header.nx+2) * (long long) (header.ny+3) * (header.nz+2),
+		(header.nx+2) * (long long) (header.ny+2) * (header.nz+3) };
+	for(int c = 0; c < 3 && ok; c++)
+		ok = header.count[c] == expected[c] && header.offset[c] % sizeof(Double) == 0 &&
+			 header.offset[c] + header.count[c] * (long long) sizeof(Double) <= (long long) file->Size();
+	if(!ok) {
+		cerr << &name[0] << " is not a velocity frame of this sequence" << endl;
+		delete file;
+		return false;
+	}
+	if(nx < 0) {
+		nx = header.nx; ny = header.ny; nz = header.nz;
+	}
+
+	file->Prefetch();
+	frame.time = header.time;
+	frame.file = file;
+	frame.field = new MACVelocity(nx, ny, nz, (Double*) (file->Data() + header.offset[0]),
+											  (Double*) (file->Data() + header.offset[1]),
+											  (Double*) (file->Data() + header.offset[2]));
+	return true;
+}
+
+void VelocitySequence::Release(Frame &frame)
+{
+	delete frame.field;
+	delete frame.file;
+	frame = Frame();
+}
+
+// the prefetched frame index, if it is ready. Otherwise makes sure it is being prefetched
+bool VelocitySequence::Take(int index, Frame &frame)
+{
+	if(!thread.Running()) return Load(index, frame);
+
+	MutexLock lock(mutex);
+	if(ready.index == index) {
+		if(ready.field == NULL) return false;	// failed to load, don't try again
+		frame = ready;
+		ready = Frame();
+		return true;
+	}
+	if(requested != index) {
+		Release(ready);
+		requested = index;
+		changed.Broadcast();
+	}
+	return false;
+}
+
+void VelocitySequence::Request(int index)
+{
+	if(!thread.Running() || index >= numFrames) return;
+	MutexLock lock(mutex);
+	if(ready.index == index || requested == index) return;
+	Release(ready);
+	requested = index;
+	changed.Broadcast();
+}
+
+void VelocitySequence::Run(void *self)
+{
+	((VelocitySequence*) self)->Prefetch();
+}
+
+void VelocitySequence::Prefetch()
+{
+	mutex.Lock();
+	for(;;) {
+		while(!quit && requested < 0) changed.Wait(mutex);
+		if(quit) break;
+		int index = requested;
+		mutex.Unlock();
+
+		Frame frame;
+		if(Load(index, frame)) {
+			// bring the pages in now rather than when the simulation first touches them
+			volatile char sum = 0;
+			const char *data = frame.file->Data();
+			for(size_t p = 0; p < frame.file->Size(); p += PAGE_SIZE) sum += data[p];
+		}
+
+		mutex.Lock();
+		if(requested == index) {
+			Release(ready);
+			ready = frame;
+			requested = -1;
+		}
+		else Release(frame);
+	}
+	mutex.Unlock();
+}
@@ -0,0 +1,139 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	VelocitySequence: A time dependent velocity field streamed from memory mapped frames
+
+	An upstream solver writes one file per frame with SaveVelocityFrame: a MACVelocity and 
+	the time it belongs to. VelocitySequence maps these files and returns the velocity at 
+	the current time (SetTime), interpolated linearly between the two frames around it. 
+	The frames are used in place, nothing is read or parsed.
+
+	Frames are assumed to be evenly spaced in time. Two frames are held at a time; while 
+	the simulation works on them, a prefetch thread maps the following frame and brings its
+	pages in (madvise where available, and by touching every page). SetTime only ever
+	switches to a frame that is completely prefetched, so the simulation never waits for 
+	the disk. If the prefetch has not finished yet, the field stays on its current pair of
+	frames (holding the later one) and Stalls is incremented; if that happens regularly, 
+	the disk is too slow for the simulation. Jumping back in time (Container::Clear, 
+	checkpoints) loads the frames it needs right away.
+
+	Functions:
+	Open			- maps the frames 0 and 1 of pattern (a printf pattern with one %d for the
+					  frame number) and starts prefetching
+	Close			- stops the prefetch thread and unmaps all frames
+	SetTime			- selects the frames for time t and the weight between them
+	Stalls			- number of times SetTime could not move on because a frame was late
+	
+	SaveVelocityFrame - writes a MACVelocity and its time as a frame file
+
+	A frame file starts with a VelocityFrameHeader followed by the u, v and w grids 
+	(Grid layout, buffer faces included) at the given offsets, each aligned to 
+	CHECKPOINT_ALIGN bytes. It is written in host byte order.
+*/
+
+#ifndef VELOCITYSEQUENCE_H
+#define VELOCITYSEQUENCE_H
+
+#include "main.h"
+#include "Velocity.h"
+#include "Thread.h"
+
+class MACVelocity;
+class MappedFile;
+
+const unsigned int VELOCITY_FRAME_VERSION = 1;
+
+struct VelocityFrameHeader
+{
+	char magic[8];					// "PLSVELF"
+	unsigned int version;
+	unsigned int byteOrder;			// CHECKPOINT_BYTEORDER as written by the saving host
+	unsigned int headerSize;
+	int nx, ny, nz;
+	Double time;
+	long long offset[3];			// of u, v and w
+	long long count[3];				// values in u, v and w
+};
+
+bool SaveVelocityFrame(const char *filename, const MACVelocity &field, Double time);
+
+class VelocitySequence : public Velocity
+{
+public:
+	VelocitySequence();
+	~VelocitySequence() { Close(); }
+
+	bool Open(const char *pattern, int numFrames);
+	void Close();
+	inline bool IsOpen() const { return frames[0].field != NULL; }
+
+	void SetTime(Double t);
+	int Stalls() const { return stalls; }
+
+	void GetVelocity(const Vector &pos, Vector &u) const;
+	void GetVelocities(const Vector *pos, Vector *u, int n) const;
+	void GetCellVelocity(int i, int j, int k, Vector &u) const;
+
+private:
+	VelocitySequence(const VelocitySequence&);
+	VelocitySequence& operator=(const VelocitySequence&);
+
+	struct Frame
+	{
+		Frame() : index(-1), time(0), file(NULL), field(NULL) {}
+		int index;
+		Double time;
+		MappedFile *file;
+		MACVelocity *field;		// on the memory of file
+	};
+
+	bool Load(int index, Frame &frame);
+	static void Release(Frame &frame);
+	bool Take(int index, Frame &frame);
+	void Request(int index);
+	static void Run(void *self);
+	void Prefetch();
+
+	string pattern;
+	int numFrames, nx, ny, nz;
+	Double start, interval;
+	Frame frames[2];			// the frames around the current time
+	Double alpha;				// weight of frames[1]
+	int stalls;
+
+	Thread thread;
+	Mutex mutex;				// guards ready, requested and quit
+	Condition changed;
+	Frame ready;				// prefetched frame
+	int requested;				// frame the prefetch thread should load, -1 for none
+	bool quit;
+};
+
+#endif
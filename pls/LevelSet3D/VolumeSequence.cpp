@@ -0,0 +1,272 @@
+#include "VolumeSequence.h"
+#include <cstring>
+
+static const int IO_BUFFER_SIZE = 1 << 20;
+
+template <class T>
+static inline void Append(vector<unsigned char> &out, const T &value)
+{
+	size_t n = out.size();
+	out.resize(n + sizeof(T));
+	memcpy(&out[n], &value, sizeof(T));
+}
+
+template <class T>
+static inline T Fetch(const char *&p)
+{
+	T value;
+	memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return value;
+}
+
+static inline int NumBricks(int cells) { return (cells + VOLUME_BRICK - 1) / VOLUME_BRICK; }
+
+// number of values stored for a brick of ni x nj x nk cells with the given band mask
+static int BandCells(const unsigned int *mask, int ni, int nj, int nk)
+{
+	int count = 0;
+	for(int k = 0; k < nk; k++) for(int j = 0; j < nj; j++) for(int i = 0; i < ni; i++) {
+		int l = i + VOLUME_BRICK*(j + VOLUME_BRICK*k);
+		if(mask[l >> 5] & (1u << (l & 31))) count++;
+	}
+	return count;
+}
+
+bool VolumeWriter::Open(const char *filename, int nx, int ny, int nz, Double bandWidth, int bits)
+{
+	if(fp != NULL) Close();
+	if(bits != 8 && bits != 16) {
+		cerr << "volume sequences store 8 or 16 bits per value" << endl;
+		return false;
+	}
+	fp = fopen(filename, "wb");
+	if(fp == NULL) {
+		cerr << "couldn't open " << filename << " for writing" << endl;
+		return false;
+	}
+	buffer = new char[IO_BUFFER_SIZE];
+	setvbuf(fp, buffer, _IOFBF, IO_BUFFER_SIZE);
+
+	memset(&header, 0, sizeof(header));
+	strcpy(header.magic, "PLSVOL");
+	header.version = VOLUME_VERSION;
+	header.headerSize = sizeof(VolumeHeader);
+	header.nx = nx; header.ny = ny; header.nz = nz;
+	header.bits = bits;
+	header.bandWidth = bandWidth;
+	fwrite(&header, sizeof(VolumeHeader), 1, fp);
+	offset = sizeof(VolumeHeader);
+	frames.clear();
+	return true;
+}
+
+bool VolumeWriter::WriteFrame(const Grid &phi)
+{
+	if(fp == NULL) return false;
+	int sx = header.nx+2, sy = header.ny+2, sz = header.nz+2;
+	if(phi.GetNx() != header.nx || phi.GetNy() != header.ny || phi.GetNz() != header.nz) {
+		cerr << "grid size doesn't match the volume sequence" << endl;
+		return false;
+	}
+	int bx = NumBricks(sx), by = NumBricks(sy), bz = NumBricks(sz);
+	int signWords = (bx*by*bz + 31) / 32;
+	Double band = header.bandWidth;
+	Double maxQ = Double((1 << header.bits) - 1);
+
+	staging.clear();
+	Append(staging, (unsigned int) 0);
+	size_t signsAt = staging.size();
+	staging.resize(signsAt + signWords * sizeof(unsigned int), 0);
+
+	unsigned int numActive = 0;
+	unsigned int mask[VOLUME_MASK_WORDS], signs[VOLUME_MASK_WORDS];
+	Double values[VOLUME_BRICK_CELLS];
+	for(int bk = 0; bk < bz; bk++) for(int bj = 0; bj < by; bj++) for(int bi = 0; bi < bx; bi++) {
+		int brick = bi + bx*(bj + by*bk);
+		int i0 = bi*VOLUME_BRICK, j0 = bj*VOLUME_BRICK, k0 = bk*VOLUME_BRICK;
+		int i1 = min(i0+VOLUME_BRICK, sx), j1 = min(j0+VOLUME_BRICK, sy), k1 = min(k0+VOLUME_BRICK, sz);
+
+		memset(mask, 0, sizeof(mask));
+		memset(signs, 0, sizeof(signs));
+		int count = 0;
+		Double lo = band, hi = -band;
+		for(int k = k0; k < k1; k++) for(int j = j0; j < j1; j++) for(int i = i0; i < i1; i++) {
+			int l = (i-i0) + VOLUME_BRICK*((j-j0) + VOLUME_BRICK*(k-k0));
+			Double value = phi(i,j,k);
+			if(value < 0.) signs[l >> 5] |= 1u << (l & 31);
+			if(abs(value) < band) {
+				mask[l >> 5] |= 1u << (l & 31);
+				values[count++] = value;
+				lo = min(lo, value); hi = max(hi, value);
+			}
+		}
+		if(count == 0) {
+			unsigned int *brickSigns = (unsigned int*) &staging[signsAt];
+			if(signs[0] & 1u) brickSigns[brick >> 5] |= 1u << (brick & 31);
+			continue;
+		}
+
+		numActive++;
+		Append(staging, (unsigned int) brick);
+		Append(staging, float(lo));
+		Append(staging, float(hi));
+		for(int w = 0; w < VOLUME_MASK_WORDS; w++) Append(staging, mask[w]);
+		for(int w = 0; w < VOLUME_MASK_WORDS; w++) Append(staging, signs[w]);
+		// quantize against the stored (float) range so that reading is exact to one step
+		Double flo = float(lo), fhi = float(hi);
+		Double scale = fhi > flo ? maxQ / (fhi - flo) : 0.;
+		for(int c = 0; c < count; c++) {
+			int q = Clamp(int((values[c] - flo) * scale + 0.5), 0, int(maxQ));
+			if(header.bits == 8) Append(staging, (unsigned char) q);
+			else                 Append(staging, (unsigned short) q);
+		}
+		while(staging.size() & 3) staging.push_back(0);
+	}
+	memcpy(&staging[0], &numActive, sizeof(unsigned int));
+
+	fwrite(&staging[0], 1, staging.size(), fp);
+	frames.push_back(offset);
+	offset += staging.size();
+	return !ferror(fp);
+}
+
+bool VolumeWriter::Close()
+{
+	if(fp == NULL) return false;
+	long long indexOffset = offset;
+	unsigned int numFrames = (unsigned int) frames.size();
+	if(numFrames > 0) fwrite(&frames[0], sizeof(long long), numFrames, fp);
+	fwrite(&indexOffset, sizeof(long long), 1, fp);
+	fwrite(&numFrames, sizeof(unsigned int), 1, fp);
+	fwrite("PLSI", 1, 4, fp);
+
+	bool ok = !ferror(fp);
+	if(fclose(fp) != 0) ok = false;
+	delete [] buffer;
+	fp = NULL;
+	buffer = NULL;
+	if(!ok) cerr << "error writing volume sequence" << endl;
+	return ok;
+}
+
+bool VolumeReader::Open(const char *filename)
+{
+	frames.clear();
+	if(!file.Open(filename)) return false;
+
+	const size_t footerSize = sizeof(long long) + sizeof(unsigned int) + 4;
+	const char *data = file.Data();
+	size_t size = file.Size();
+	if(size >= sizeof(VolumeHeader) + footerSize) {
+		memcpy(&header, data, sizeof(VolumeHeader));
+		const char *footer = data + size - footerSize;
+		indexOffset = Fetch<long long>(footer);
+		unsigned int numFrames = Fetch<unsigned int>(footer);
+		if(strncmp(header.magic, "PLSVOL", 8) == 0 && header.version == VOLUME_VERSION &&
+		   header.headerSize == sizeof(VolumeHeader) && memcmp(footer, "PLSI", 4) == 0 &&
+		   (header.bits == 8 || header.bits == 16) && 
+		   header.nx > 0 && header.ny > 0 && header.nz > 0 &&
+		   indexOffset >= (long long) sizeof(VolumeHeader) &&
+		   indexOffset + numFrames * (long long) sizeof(long long) + (long long) footerSize 
+				== (long long) size) {
+			frames.resize(numFrames);
+			if(numFrames > 0) 
+				memcpy(&frames[0], data + indexOffset, numFrames * sizeof(long long));
+			// the frames have to follow each other between the header and the index
+			bool ordered = true;
+			for(unsigned int f = 0; f < numFrames; f++)
+				if(frames[f] < (f > 0 ? frames[f-1] : (long long) sizeof(VolumeHeader)) || 
+				   frames[f] > indexOffset) ordered = false;
+			if(ordered) return true;
+			frames.clear();
+		}
+	}
+	cerr << filename << " is not a volume sequence" << endl;
+	file.Close();
+	return false;
+}
+
+bool VolumeReader::ReadFrame(int frame, Grid &phi) const
+{
+	if(frame < 0 || frame >= NumFrames()) return false;
+	if(phi.GetNx() != header.nx || phi.GetNy() != header.ny || phi.GetNz() != header.nz) {
+		cerr << "grid size doesn't match the volume sequence" << endl;
+		return false;
+	}
+	int sx = header.nx+2, sy = header.ny+2, sz = header.nz+2;
+	int bx = NumBricks(sx), by = NumBricks(sy), bz = NumBricks(sz);
+	int signWords = (bx*by*bz + 31) / 32;
+	Double band = header.bandWidth;
+	Double maxQ = Double((1 << header.bits) - 1);
+
+	const char *p = file.Data() + frames[frame];
+	const char *end = file.Data() + (frame+1 < NumFrames() ? frames[frame+1] : indexOffset);
+	unsigned int mask[VOLUME_MASK_WORDS], signs[VOLUME_MASK_WORDS];
+
+	// check that every brick of the frame is one of the grid and fits into the frame before
+	// anything is written
+	const size_t brickHeader = sizeof(unsigned int) + 2*sizeof(float) + sizeof(mask) + sizeof(signs);
+	bool damaged = size_t(end - p) < (1 + signWords) * sizeof(unsigned int);
+	unsigned int numActive = damaged ? 0 : Fetch<unsigned int>(p);
+	const char *q = p + signWords * sizeof(unsigned int);
+	if(numActive > unsigned(bx*by*bz)) damaged = true;
+	for(unsigned int a = 0; a < numActive && !damaged; a++) {
+		if(size_t(end - q) < brickHeader) { damaged = true; break; }
+		unsigned int brick = Fetch<unsigned int>(q);
+		q += 2*sizeof(float);
+		memcpy(mask, q, sizeof(mask)); q += sizeof(mask) + sizeof(signs);
+		if(brick >= unsigned(bx*by*bz)) { damaged = true; break; }
+		int bi = brick % bx, bj = (brick / bx) % by, bk = brick / (bx*by);
+		int ni = min(VOLUME_BRICK, sx - bi*VOLUME_BRICK), nj = min(VOLUME_BRICK, sy - bj*VOLUME_BRICK);
+		int nk = min(VOLUME_BRICK, sz - bk*VOLUME_BRICK);
+		size_t bytes = BandCells(mask, ni, nj, nk) * size_t(header.bits / 8);
+		bytes += (4 - bytes % 4) % 4;
+		if(size_t(end - q) < bytes) damaged = true;
+		else q += bytes;
+	}
+	if(damaged) {
+		cerr << "frame " << frame << " of the volume sequence is damaged" << endl;
+		return false;
+	}
+	if(phi.GetGhost() > 1) phi.SetBoundarySignedDist();
+
+	const char *brickSigns = p;
+	p += signWords * sizeof(unsigned int);
+
+	// bricks without band cells
+	for(int bk = 0; bk < bz; bk++) for(int bj = 0; bj < by; bj++) for(int bi = 0; bi < bx; bi++) {
+		int brick = bi + bx*(bj + by*bk);
+		unsigned int word;
+		memcpy(&word, brickSigns + (brick >> 5) * sizeof(unsigned int), sizeof(unsigned int));
+		Double value = (word >> (brick & 31)) & 1u ? -band : band;
+		int i0 = bi*VOLUME_BRICK, j0 = bj*VOLUME_BRICK, k0 = bk*VOLUME_BRICK;
+		int i1 = min(i0+VOLUME_BRICK, sx), j1 = min(j0+VOLUME_BRICK, sy), k1 = min(k0+VOLUME_BRICK, sz);
+		for(int k = k0; k < k1; k++) for(int j = j0; j < j1; j++) for(int i = i0; i < i1; i++)
+			phi(i,j,k) = value;
+	}
+
+	for(unsigned int a = 0; a < numActive; a++) {
+		int brick = int(Fetch<unsigned int>(p));
+		Double lo = Fetch<float>(p), hi = Fetch<float>(p);
+		memcpy(mask, p, sizeof(mask));   p += sizeof(mask);
+		memcpy(signs, p, sizeof(signs)); p += sizeof(signs);
+		Double step = (hi - lo) / maxQ;
+
+		int bi = brick % bx, bj = (brick / bx) % by, bk = brick / (bx*by);
+		int i0 = bi*VOLUME_BRICK, j0 = bj*VOLUME_BRICK, k0 = bk*VOLUME_BRICK;
+		int i1 = min(i0+VOLUME_BRICK, sx), j1 = min(j0+VOLUME_BRICK, sy), k1 = min(k0+VOLUME_BRICK, sz);
+		const char *start = p;
+		for(int k = k0; k < k1; k++) for(int j = j0; j < j1; j++) for(int i = i0; i < i1; i++) {
+			int l = (i-i0) + VOLUME_BRICK*((j-j0) + VOLUME_BRICK*(k-k0));
+			unsigned int bit = 1u << (l & 31);
+			if(mask[l >> 5] & bit) {
+				int q = header.bits == 8 ? int(Fetch<unsigned char>(p)) : int(Fetch<unsigned short>(p));
+				phi(i,j,k) = lo + q * step;
+			}
+			else phi(i,j,k) = signs[l >> 5] & bit ? -band : band;
+		}
+		p += (4 - (p - start) % 4) % 4;
+	}
+	return true;
+}
@@ -0,0 +1,122 @@
+/**************************************************************************
+	ORIGINAL AUTHOR: 
+		Emud Mokhberi (emud@ucla.edu)
+	MODIFIED BY:
+	
+	CONTRIBUTORS:
+	
+
+-----------------------------------------------
+	
+ ***************************************************************
+ ******General License Agreement and Lack of Warranty ***********
+ ****************************************************************
+
+ This software is distributed for noncommercial use in the hope that it will 
+ be useful but WITHOUT ANY WARRANTY. The author(s) do not accept responsibility
+ to anyone for the consequences of using it or for whether it serves any 
+ particular purpose or works at all. No guarantee is made about the software 
+ or its performance.
+
+ You are allowed to modify the source code, add your name to the
+ appropriate list above and distribute the code as long as 
+ this license agreement is distributed with the code and is included at 
+ the top of all header (.h) files.
+
+ Commercial use is strictly prohibited.
+***************************************************************************/
+
+
+/*
+	VolumeSequence: Compact storage of the level set for a sequence of frames
+
+	Only the cells in the narrow band (|phi| < bandWidth) are stored. The grid (buffer cells
+	included) is cut into bricks of VOLUME_BRICK^3 cells. A brick that contains band cells
+	stores a mask of its band cells, a mask of the signs of all its cells and the band values
+	quantized to 8 or 16 bits between the smallest and largest band value of the brick. For
+	every other brick only its sign is stored. When a frame is read back, cells outside of 
+	the band are set to +/- bandWidth. Only the first layer of buffer cells is stored; on a 
+	grid with a wider buffer the outer layers are set as Grid::SetBoundarySignedDist does.
+
+	VolumeWriter:
+	Open		- creates the file. bits is 8 or 16
+	WriteFrame	- appends the grid as the next frame
+	Close		- writes the frame index. A file that was not closed can't be read
+
+	VolumeReader:
+	Open		- maps the file and reads the frame index
+	NumFrames	- number of frames in the file
+	ReadFrame	- reconstructs the given frame (any order) into a grid of the same size.
+				  A frame whose bricks don't fit into it (a damaged file) is rejected before
+				  anything is written to the grid
+
+	File layout (host byte order):
+		VolumeHeader
+		frames		- uint number of active bricks, uint[] inactive brick signs (one bit per 
+					  brick), then per active brick: uint brick index, float lo, hi, 
+					  uint[16] band mask, uint[16] sign mask, quantized values (padded to 4 bytes)
+		index		- long long offset of every frame
+		footer		- long long offset of the index, uint number of frames, "PLSI"
+*/
+
+#ifndef VOLUMESEQUENCE_H
+#define VOLUMESEQUENCE_H
+
+#include "main.h"
+#include "Grid.h"
+#include "MappedFile.h"
+
+const int VOLUME_BRICK = 8;
+const int VOLUME_BRICK_CELLS = VOLUME_BRICK * VOLUME_BRICK * VOLUME_BRICK;
+const int VOLUME_MASK_WORDS = VOLUME_BRICK_CELLS / 32;
+const unsigned int VOLUME_VERSION = 1;
+
+struct VolumeHeader
+{
+	char magic[8];				// "PLSVOL"
+	unsigned int version;
+	unsigned int headerSize;
+	int nx, ny, nz;
+	int bits;
+	Double bandWidth;
+};
+
+class VolumeWriter
+{
+public:
+	VolumeWriter() : fp(NULL), buffer(NULL) {}
+	~VolumeWriter() { if(fp != NULL) Close(); }
+
+	bool Open(const char *filename, int nx, int ny, int nz, Double bandWidth, int bits = 16);
+	bool WriteFrame(const Grid &phi);
+	bool Close();
+	inline bool IsOpen() const { return fp != NULL; }
+
+private:
+	VolumeWriter(const VolumeWriter&);
+	VolumeWriter& operator=(const VolumeWriter&);
+
+	FILE *fp;
+	char *buffer;
+	VolumeHeader header;
+	long long offset;
+	vector<long long> frames;
+	vector<unsigned char> staging;
+};
+
+class VolumeReader
+{
+public:
+	bool Open(const char *filename);
+	inline int NumFrames() const { return int(frames.size()); }
+	inline const VolumeHeader& Header() const { return header; }
+	bool ReadFrame(int frame, Grid &phi) const;
+
+private:
+	MappedFile file;
+	VolumeHeader header;
+	vector<long long> frames;
+	long long indexOffset;		// end of the last frame
+};
+
+#endif
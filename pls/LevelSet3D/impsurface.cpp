@@ -115,12 +115,16 @@ void IsoSurface::glDraw ()
 	glDrawElements(GL_TRIANGLES, (GLsizei) faces.size() * 3, GL_UNSIGNED_INT, &faces[0][0]);
 }
 
+/*
+ * Computes the normals of the vertices that don't have one yet. The normal
+ * array is only emptied by clear(), so a mesh that is built and streamed
+ * layer by layer never evaluates a normal twice.
+ */
 void IsoSurface::calcVNorms ()
 {
 	int numV = (int)vertices.size();
-	vNormals.clear();
 
-	for (int i = 0; i < numV; ++i)
+	for (int i = (int)vNormals.size(); i < numV; ++i)
 	{
 		try
 		{
@@ -141,6 +145,16 @@ void IsoSurface::clear ()
 	vNormals.clear();
 }
 
+/*
+ * Exchanges the meshes of the two surfaces without copying. The functions stay
+ */
+void IsoSurface::swap (IsoSurface& other)
+{
+	vertices.swap(other.vertices);
+	faces.swap(other.faces);
+	vNormals.swap(other.vNormals);
+}
+
 ImpSurface* IsoSurface::getFunction ()
 {
 	return function;
@@ -199,4 +213,4 @@ ostream& operator << (ostream& out, const IsoSurface& s)
 
 	out << "}" << endl;
 	return out;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -34,6 +34,7 @@
 
 class ImpSurface;
 class IsoSurface;
+class IsoSurfaceSink;
 
 const Double GRAD_EPSILON = 1e-5;
 const Double GRAD_EPS_INV = 1.0 / GRAD_EPSILON;
@@ -73,9 +74,14 @@ public:
 	void	calcVNorms	();
 
 	void	clear		();
+	void	swap		(IsoSurface& other);
 
 	ImpSurface*	getFunction	();
 
+	const vector<Point3d>&		getVertices	() const { return vertices; }
+	const vector<Vector3d>&		getNormals	() const { return vNormals; }
+	const vector<MeshTriangle>&	getFaces	() const { return faces; }
+
 	friend ostream& operator <<		(ostream& out, const IsoSurface& s);
 private:
 	ImpSurface*				function;
@@ -84,4 +90,19 @@ private:
 	vector<Vector3d>		vNormals;
 };
 
-#endif // IMPSURFACE_H
\ No newline at end of file
+/*
+ * Receives the mesh while it is being built. MarchCube calls layerDone once
+ * per finished z-layer; vertices from firstVertex and faces from firstFace
+ * onward are new, and normals are already computed for the new vertices.
+ * Faces only reference vertices that have been handed out before.
+ */
+class IsoSurfaceSink
+{
+public:
+	virtual ~IsoSurfaceSink	() {}
+
+	virtual void	layerDone	(const IsoSurface& surface, 
+								 int firstVertex, int firstFace) = 0;
+};
+
+#endif // IMPSURFACE_H
\ No newline at end of file
@@ -12,7 +12,8 @@ MarchCube::MarchCube ()
   resx(1),
   resy(1),
   resz(1),
-  center(Point3d(0, 0, 0))
+  center(Point3d(0, 0, 0)),
+  sink(NULL)
 {
 	initGrids();
 }
@@ -81,8 +82,10 @@ void MarchCube::march (IsoSurface& surface)
 	 * examined, followed by those on the right edge of the grid.
 	 */
 
+	int streamedVertices = 0;
 	for (int layer = 1; layer <= resz; ++layer)
 	{
+		int firstFace = (int) surface.getFaces().size();
 //		cerr << "filling in layer " << layer << endl;
 		if (layer > 1)
 		{
@@ -149,7 +152,6 @@ void MarchCube::march (IsoSurface& surface)
 		int* indices;
 		int e0, e1, e2;
 		int v0, v1, v2;
-		static int badV = 0;
 		for (int i = 0; i < resx; ++i)
 		{
 			for (int j = 0; j < resy; ++j)
@@ -168,6 +170,17 @@ void MarchCube::march (IsoSurface& surface)
 			}
 		}
 
+		/*
+		 * Hand the finished layer to the sink. Vertices from the back of the
+		 * grid are included with the first layer.
+		 */
+		if (sink)
+		{
+			surface.calcVNorms();
+			sink->layerDone(surface, streamedVertices, firstFace);
+			streamedVertices = (int) surface.getVertices().size();
+		}
+
 		/*
 		 * Move the vertex/edge-index grids one step forward
 		 */
@@ -224,6 +237,11 @@ void MarchCube::setCenter (Double x, Double y, Double z)
 	center[2] = z;
 }
 
+void MarchCube::setSink (IsoSurfaceSink* sink_)
+{
+	sink = sink_;
+}
+
 void MarchCube::clearGrids ()
 {
 	if (vtxGrid)
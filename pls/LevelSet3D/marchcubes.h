@@ -85,6 +85,7 @@ public:
 	void	setRes			(int x, int y, int z);
 	void	setCenter		(const Point3d& center_);
 	void	setCenter		(Double x, Double y, Double z);
+	void	setSink			(IsoSurfaceSink* sink_);
 
 private:
 	void	clearGrids		();
@@ -140,6 +141,13 @@ private:
 	int			resy;
 	int			resz;
 	Point3d		center;
+
+	/*
+	 * Optional receiver of each finished layer (see IsoSurfaceSink). When set,
+	 * normals are computed per layer so the mesh can be written out while the
+	 * rest of the volume is still being marched.
+	 */
+	IsoSurfaceSink*	sink;
 };
 
 class CubeVtx
@@ -168,4 +176,4 @@ private:
 	Double		value;
 };
 
-#endif // MARCHCUBES_H
\ No newline at end of file
+#endif // MARCHCUBES_H
\ No newline at end of file